@@ -0,0 +1,333 @@
+#include "core/compiled_format.h"
+#include "core/format.h"
+#include "core/stdlib/cstring.h"
+
+using namespace rtk;
+
+namespace {
+constexpr size_t kFillChunk = 16;
+
+// The argument as `size` bytes, sign-extended for signed conversions
+uintmax_t Narrow(uintmax_t value, size_t size, bool isSigned) {
+  if (size >= sizeof(uintmax_t))
+    return value;
+  const auto bits = size * 8;
+  value &= (uintmax_t{1} << bits) - 1;
+  if (isSigned && (value >> (bits - 1)) != 0)
+    value |= ~uintmax_t{0} << bits;
+  return value;
+}
+
+void RenderNumber(const FormatOp& op, const FormatArg& arg,
+                  FormatOutput& out) {
+  const auto isSigned = op.conversion == FormatConversion::Signed;
+  // A wider length modifier sees the argument sign-extended
+  auto value = arg.value;
+  if (arg.isSigned)
+    value = Narrow(value, arg.size, true);
+  value = Narrow(value, op.size != 0 ? op.size : arg.size, isSigned);
+  const auto negative = isSigned && static_cast<intmax_t>(value) < 0;
+  if (negative)
+    value = ~value + 1;
+
+  char digits[24];  // 22 octal digits for 64 bits
+  int count;
+  switch (op.conversion) {
+    case FormatConversion::Octal:
+      count = todigits<8>(value, digits);
+      break;
+    case FormatConversion::Hex:
+    case FormatConversion::Pointer:
+      count = todigits<16, false>(value, digits);
+      break;
+    case FormatConversion::HexUpper:
+      count = todigits<16, true>(value, digits);
+      break;
+    default:
+      count = todigits<10>(value, digits);
+      break;
+  }
+  size_t length = static_cast<size_t>(count);
+  // A precision of 0 prints nothing for 0
+  if (op.precision == 0 && value == 0)
+    length = 0;
+  size_t zeros =
+      op.precision > 0 && static_cast<size_t>(op.precision) > length
+          ? static_cast<size_t>(op.precision) - length
+          : 0;
+
+  char prefix[2]{};
+  size_t prefixLength = 0;
+  if (negative) {
+    prefix[prefixLength++] = '-';
+  } else if (isSigned && (op.flags & FormatOp::kPlus) != 0) {
+    prefix[prefixLength++] = '+';
+  } else if (isSigned && (op.flags & FormatOp::kSpace) != 0) {
+    prefix[prefixLength++] = ' ';
+  }
+  if ((op.flags & FormatOp::kHash) != 0) {
+    if (op.conversion == FormatConversion::Octal) {
+      if (zeros == 0 && (length == 0 || *digits != '0'))
+        zeros = 1;
+    } else if (value != 0 && (op.conversion == FormatConversion::Hex ||
+                              op.conversion == FormatConversion::HexUpper)) {
+      prefix[prefixLength++] = '0';
+      prefix[prefixLength++] =
+          op.conversion == FormatConversion::Hex ? 'x' : 'X';
+    }
+  }
+
+  const auto total = prefixLength + zeros + length;
+  const size_t pad = op.width > total ? op.width - total : 0;
+  const auto left = (op.flags & FormatOp::kLeft) != 0;
+  // Zero padding goes between the prefix and the digits
+  if (!left && (op.flags & FormatOp::kZero) != 0 && op.precision < 0) {
+    zeros += pad;
+  } else if (!left) {
+    out.fill(' ', pad);
+  }
+  if (prefixLength > 0)
+    out.put(prefix, prefixLength);
+  out.fill('0', zeros);
+  if (length > 0)
+    out.put(digits, length);
+  if (left)
+    out.fill(' ', pad);
+}
+
+// Float output as text and runs of '0', measured before it's put
+class FloatPieces {
+ public:
+  void text(const char* chars, size_t length) {
+    if (length > 0)
+      add(chars, length);
+  }
+  void zeros(size_t count) {
+    if (count > 0)
+      add(nullptr, count);
+  }
+  size_t length() const { return length_; }
+  void put(FormatOutput& out) const {
+    for (int i = 0; i < count_; i++) {
+      if (pieces_[i].chars != nullptr) {
+        out.put(pieces_[i].chars, pieces_[i].length);
+      } else {
+        out.fill('0', pieces_[i].length);
+      }
+    }
+  }
+
+ private:
+  struct Piece {
+    const char* chars;  // nullptr for zeros
+    size_t length;
+  };
+  void add(const char* chars, size_t length) {
+    pieces_[count_++] = {chars, length};
+    length_ += length;
+  }
+  Piece pieces_[8];
+  int count_ = 0;
+  size_t length_ = 0;
+};  // class FloatPieces
+
+// %f with `precision` digits after the point; `trim` drops trailing zeros
+// from the fraction, as %g does
+void FixedPieces(DecimalFloat& decimal, double value, int precision,
+                 bool hash, bool trim, FloatPieces& pieces) {
+  RoundDecimal(decimal, value, decimal.point + precision);
+  const auto point = decimal.point;
+  const auto length = decimal.length;
+  if (point <= 0) {
+    pieces.text("0", 1);
+  } else {
+    const auto integral = point < length ? point : length;
+    pieces.text(decimal.digits, integral);
+    pieces.zeros(point - integral);
+  }
+  // Zeros between the point and the first digit
+  const auto leading =
+      point < 0 ? (-point < precision ? -point : precision) : 0;
+  const auto start = point > 0 ? point : 0;
+  const auto available = length > start ? length - start : 0;
+  const auto shown =
+      available < precision - leading ? available : precision - leading;
+  const auto fraction = trim ? (shown > 0 ? leading + shown : 0) : precision;
+  if (fraction > 0 || hash)
+    pieces.text(".", 1);
+  if (fraction > 0) {
+    pieces.zeros(leading);
+    pieces.text(decimal.digits + start, shown);
+    pieces.zeros(fraction - leading - shown);
+  }
+}
+
+// %e with `precision` digits after the point. `exponent` holds the
+// exponent's text until the pieces are put.
+void ExponentPieces(DecimalFloat& decimal, double value, int precision,
+                    bool hash, bool trim, bool upper, char* exponent,
+                    FloatPieces& pieces) {
+  RoundDecimal(decimal, value, precision + 1);
+  const auto shown =
+      decimal.length - 1 < precision ? decimal.length - 1 : precision;
+  const auto fraction = trim ? shown : precision;
+  pieces.text(decimal.digits, 1);
+  if (fraction > 0 || hash)
+    pieces.text(".", 1);
+  pieces.text(decimal.digits + 1, shown);
+  pieces.zeros(fraction - shown);
+
+  auto power = decimal.point - 1;
+  size_t chars = 0;
+  exponent[chars++] = upper ? 'E' : 'e';
+  exponent[chars++] = power < 0 ? '-' : '+';
+  power = power < 0 ? -power : power;
+  if (power < 10)
+    exponent[chars++] = '0';
+  chars += todigits<10>(static_cast<uintmax_t>(power), exponent + chars);
+  pieces.text(exponent, chars);
+}
+
+void RenderText(const FormatOp& op, const char* text, size_t length,
+                FormatOutput& out) {
+  const size_t pad = op.width > length ? op.width - length : 0;
+  const auto left = (op.flags & FormatOp::kLeft) != 0;
+  if (!left)
+    out.fill(' ', pad);
+  if (length > 0)
+    out.put(text, length);
+  if (left)
+    out.fill(' ', pad);
+}
+}  // namespace
+
+void rtk::RenderFloat(const FormatOp& op, double value, FormatOutput& out) {
+  const auto bits = __builtin_bit_cast(uint64_t, value);
+  const auto negative = (bits >> 63) != 0;
+  const auto finite = ((bits >> 52) & 0x7FF) != 0x7FF;
+  const auto upper = op.conversion == FormatConversion::FixedUpper ||
+                     op.conversion == FormatConversion::ExponentUpper ||
+                     op.conversion == FormatConversion::GeneralUpper;
+  const auto hash = (op.flags & FormatOp::kHash) != 0;
+
+  // The pieces point into these
+  DecimalFloat decimal;
+  char exponent[8];
+  FloatPieces pieces;
+  if (!finite) {
+    const auto nan = (bits << 12) != 0;
+    pieces.text(nan ? (upper ? "NAN" : "nan") : (upper ? "INF" : "inf"), 3);
+  } else {
+    decimal = ShortestDecimal(value);
+    switch (op.conversion) {
+      case FormatConversion::Fixed:
+      case FormatConversion::FixedUpper:
+        FixedPieces(decimal, value, op.precision < 0 ? 6 : op.precision, hash,
+                    false, pieces);
+        break;
+      case FormatConversion::Exponent:
+      case FormatConversion::ExponentUpper:
+        ExponentPieces(decimal, value, op.precision < 0 ? 6 : op.precision,
+                       hash, false, upper, exponent, pieces);
+        break;
+      default: {
+        // %e for exponents below -4 or from the precision up, else %f, with
+        // `precision` significant digits either way
+        const int precision =
+            op.precision < 0 ? 6 : op.precision == 0 ? 1 : op.precision;
+        RoundDecimal(decimal, value, precision);
+        const auto power = decimal.point - 1;
+        if (power >= -4 && power < precision) {
+          FixedPieces(decimal, value, precision - 1 - power, hash, !hash,
+                      pieces);
+        } else {
+          ExponentPieces(decimal, value, precision - 1, hash, !hash, upper,
+                         exponent, pieces);
+        }
+        break;
+      }
+    }
+  }
+
+  char sign = '\0';
+  if (negative) {
+    sign = '-';
+  } else if ((op.flags & FormatOp::kPlus) != 0) {
+    sign = '+';
+  } else if ((op.flags & FormatOp::kSpace) != 0) {
+    sign = ' ';
+  }
+  const auto total = pieces.length() + (sign != '\0');
+  const size_t pad = op.width > total ? op.width - total : 0;
+  const auto left = (op.flags & FormatOp::kLeft) != 0;
+  const auto zeroPad = !left && finite && (op.flags & FormatOp::kZero) != 0;
+  if (!left && !zeroPad)
+    out.fill(' ', pad);
+  if (sign != '\0')
+    out.put(&sign, 1);
+  if (zeroPad)
+    out.fill('0', pad);
+  pieces.put(out);
+  if (left)
+    out.fill(' ', pad);
+}
+
+void FormatOutput::fill(char c, size_t count) {
+  if (count == 0)
+    return;
+  char chunk[kFillChunk];
+  rtk::memset(chunk, c, count < kFillChunk ? count : kFillChunk);
+  for (; count > kFillChunk; count -= kFillChunk)
+    put(chunk, kFillChunk);
+  put(chunk, count);
+}
+
+void BufferFormatOutput::put(const char* chars, size_t length) {
+  if (length_ + 1 < size_) {
+    const auto room = size_ - 1 - length_;
+    rtk::memcpy(buffer_ + length_, chars, length < room ? length : room);
+  }
+  length_ += length;
+}
+
+size_t BufferFormatOutput::finish() {
+  if (size_ > 0)
+    buffer_[length_ < size_ ? length_ : size_ - 1] = '\0';
+  return length_;
+}
+
+void rtk::RenderFormat(const char* format, const FormatOp* ops, size_t count,
+                       const FormatArg* args, FormatOutput& out) {
+  for (size_t i = 0; i < count; i++) {
+    const auto& op = ops[i];
+    switch (op.conversion) {
+      case FormatConversion::Literal:
+        out.put(format + op.offset, op.length);
+        continue;
+      case FormatConversion::Char: {
+        const auto c = static_cast<char>(args->value);
+        RenderText(op, &c, 1, out);
+        break;
+      }
+      case FormatConversion::String: {
+        auto length = args->length;
+        if (op.precision >= 0 && static_cast<size_t>(op.precision) < length)
+          length = static_cast<size_t>(op.precision);
+        RenderText(op, args->str, length, out);
+        break;
+      }
+      case FormatConversion::Fixed:
+      case FormatConversion::FixedUpper:
+      case FormatConversion::Exponent:
+      case FormatConversion::ExponentUpper:
+      case FormatConversion::General:
+      case FormatConversion::GeneralUpper:
+        RenderFloat(op, args->real, out);
+        break;
+      default:
+        RenderNumber(op, *args, out);
+        break;
+    }
+    args++;
+  }
+}
@@ -0,0 +1,356 @@
+#include "core/float_format.h"
+#include "core/format.h"
+
+using namespace rtk;
+
+// Grisu2, after Florian Loitsch, "Printing Floating-Point Numbers Quickly
+// and Accurately with Integers" (PLDI 2010). The digits always read back as
+// the same double and are nearly always the shortest that do.
+namespace {
+constexpr uint64_t kHiddenBit = uint64_t{1} << 52;
+constexpr uint64_t kSignificandMask = kHiddenBit - 1;
+constexpr int kExponentBias = 1075;  // 1023 plus the 52 fraction bits
+
+// f * 2^e
+struct DiyFp {
+  uint64_t f;
+  int e;
+
+  DiyFp operator-(const DiyFp& rhs) const { return {f - rhs.f, e}; }
+  // The upper half of the product, rounded
+  DiyFp operator*(const DiyFp& rhs) const {
+    const auto product = static_cast<unsigned __int128>(f) * rhs.f;
+    auto high = static_cast<uint64_t>(product >> 64);
+    high += (static_cast<uint64_t>(product) >> 63) & 1;
+    return {high, e + rhs.e + 64};
+  }
+  DiyFp normalize() const {
+    const auto shift = __builtin_clzll(f);
+    return {f << shift, e - shift};
+  }
+};  // struct DiyFp
+
+// 10^K for K = -348, -340, ..., 340, normalized and rounded to nearest
+constexpr DiyFp kCachedPowers[] = {
+    {0xfa8fd5a0081c0288ULL, -1220}, {0xbaaee17fa23ebf76ULL, -1193},
+    {0x8b16fb203055ac76ULL, -1166}, {0xcf42894a5dce35eaULL, -1140},
+    {0x9a6bb0aa55653b2dULL, -1113}, {0xe61acf033d1a45dfULL, -1087},
+    {0xab70fe17c79ac6caULL, -1060}, {0xff77b1fcbebcdc4fULL, -1034},
+    {0xbe5691ef416bd60cULL, -1007}, {0x8dd01fad907ffc3cULL, -980},
+    {0xd3515c2831559a83ULL, -954}, {0x9d71ac8fada6c9b5ULL, -927},
+    {0xea9c227723ee8bcbULL, -901}, {0xaecc49914078536dULL, -874},
+    {0x823c12795db6ce57ULL, -847}, {0xc21094364dfb5637ULL, -821},
+    {0x9096ea6f3848984fULL, -794}, {0xd77485cb25823ac7ULL, -768},
+    {0xa086cfcd97bf97f4ULL, -741}, {0xef340a98172aace5ULL, -715},
+    {0xb23867fb2a35b28eULL, -688}, {0x84c8d4dfd2c63f3bULL, -661},
+    {0xc5dd44271ad3cdbaULL, -635}, {0x936b9fcebb25c996ULL, -608},
+    {0xdbac6c247d62a584ULL, -582}, {0xa3ab66580d5fdaf6ULL, -555},
+    {0xf3e2f893dec3f126ULL, -529}, {0xb5b5ada8aaff80b8ULL, -502},
+    {0x87625f056c7c4a8bULL, -475}, {0xc9bcff6034c13053ULL, -449},
+    {0x964e858c91ba2655ULL, -422}, {0xdff9772470297ebdULL, -396},
+    {0xa6dfbd9fb8e5b88fULL, -369}, {0xf8a95fcf88747d94ULL, -343},
+    {0xb94470938fa89bcfULL, -316}, {0x8a08f0f8bf0f156bULL, -289},
+    {0xcdb02555653131b6ULL, -263}, {0x993fe2c6d07b7facULL, -236},
+    {0xe45c10c42a2b3b06ULL, -210}, {0xaa242499697392d3ULL, -183},
+    {0xfd87b5f28300ca0eULL, -157}, {0xbce5086492111aebULL, -130},
+    {0x8cbccc096f5088ccULL, -103}, {0xd1b71758e219652cULL, -77},
+    {0x9c40000000000000ULL, -50}, {0xe8d4a51000000000ULL, -24},
+    {0xad78ebc5ac620000ULL, 3}, {0x813f3978f8940984ULL, 30},
+    {0xc097ce7bc90715b3ULL, 56}, {0x8f7e32ce7bea5c70ULL, 83},
+    {0xd5d238a4abe98068ULL, 109}, {0x9f4f2726179a2245ULL, 136},
+    {0xed63a231d4c4fb27ULL, 162}, {0xb0de65388cc8ada8ULL, 189},
+    {0x83c7088e1aab65dbULL, 216}, {0xc45d1df942711d9aULL, 242},
+    {0x924d692ca61be758ULL, 269}, {0xda01ee641a708deaULL, 295},
+    {0xa26da3999aef774aULL, 322}, {0xf209787bb47d6b85ULL, 348},
+    {0xb454e4a179dd1877ULL, 375}, {0x865b86925b9bc5c2ULL, 402},
+    {0xc83553c5c8965d3dULL, 428}, {0x952ab45cfa97a0b3ULL, 455},
+    {0xde469fbd99a05fe3ULL, 481}, {0xa59bc234db398c25ULL, 508},
+    {0xf6c69a72a3989f5cULL, 534}, {0xb7dcbf5354e9beceULL, 561},
+    {0x88fcf317f22241e2ULL, 588}, {0xcc20ce9bd35c78a5ULL, 614},
+    {0x98165af37b2153dfULL, 641}, {0xe2a0b5dc971f303aULL, 667},
+    {0xa8d9d1535ce3b396ULL, 694}, {0xfb9b7cd9a4a7443cULL, 720},
+    {0xbb764c4ca7a44410ULL, 747}, {0x8bab8eefb6409c1aULL, 774},
+    {0xd01fef10a657842cULL, 800}, {0x9b10a4e5e9913129ULL, 827},
+    {0xe7109bfba19c0c9dULL, 853}, {0xac2820d9623bf429ULL, 880},
+    {0x80444b5e7aa7cf85ULL, 907}, {0xbf21e44003acdd2dULL, 933},
+    {0x8e679c2f5e44ff8fULL, 960}, {0xd433179d9c8cb841ULL, 986},
+    {0x9e19db92b4e31ba9ULL, 1013}, {0xeb96bf6ebadf77d9ULL, 1039},
+    {0xaf87023b9bf0ee6bULL, 1066},
+};
+constexpr int kFirstCachedPower = -348;
+constexpr int kCachedPowerStep = 8;
+
+// A cached power whose product with a normalized DiyFp of exponent `e`
+// has an exponent in [-60, -32]; sets `k` to minus its decimal exponent
+DiyFp CachedPower(int e, int& k) {
+  // ceil((-61 - e) * log10(2)), with 78913 / 2^18 ~ log10(2)
+  const auto x = -61 - e;
+  const auto ceilLog10 = x == 0 ? 0 : ((x * 78913) >> 18) + 1;
+  const auto index =
+      static_cast<size_t>((ceilLog10 - kFirstCachedPower - 1) /
+                          kCachedPowerStep + 1);
+  k = -(kFirstCachedPower + static_cast<int>(index) * kCachedPowerStep);
+  return kCachedPowers[index];
+}
+
+// Moves the last digit down while that brings it closer to `w`
+void Round(char* digits, int length, uint64_t delta, uint64_t rest,
+           uint64_t tenKappa, uint64_t distance) {
+  while (rest < distance && delta - rest >= tenKappa &&
+         (rest + tenKappa < distance ||
+          distance - rest > rest + tenKappa - distance)) {
+    digits[length - 1]--;
+    rest += tenKappa;
+  }
+}
+
+// Generates digits of `high` until they fall within `delta` of it
+void GenerateDigits(const DiyFp& w, const DiyFp& high, uint64_t delta,
+                    char* digits, int& length, int& k) {
+  const DiyFp one{uint64_t{1} << -high.e, high.e};
+  const auto distance = (high - w).f;
+  auto integral = static_cast<uint32_t>(high.f >> -one.e);
+  auto fraction = high.f & (one.f - 1);
+  auto kappa = countdigits<10>(integral);
+  length = 0;
+  while (kappa > 0) {
+    const auto power = static_cast<uint32_t>(detail::kPowersOf10[kappa - 1]);
+    const auto digit = integral / power;
+    integral %= power;
+    if (digit != 0 || length != 0)
+      digits[length++] = static_cast<char>('0' + digit);
+    kappa--;
+    const auto rest = (static_cast<uint64_t>(integral) << -one.e) + fraction;
+    if (rest <= delta) {
+      k += kappa;
+      Round(digits, length, delta, rest, detail::kPowersOf10[kappa] << -one.e,
+            distance);
+      return;
+    }
+  }
+  while (true) {
+    fraction *= 10;
+    delta *= 10;
+    const auto digit = static_cast<char>(fraction >> -one.e);
+    if (digit != 0 || length != 0)
+      digits[length++] = static_cast<char>('0' + digit);
+    fraction &= one.f - 1;
+    kappa--;
+    if (fraction < delta) {
+      k += kappa;
+      const auto index = -kappa;
+      Round(digits, length, delta, fraction, one.f,
+            index < 20 ? distance * detail::kPowersOf10[index] : 0);
+      return;
+    }
+  }
+}
+
+// An unsigned integer of up to 1024 bits: room for a double's exact value
+// or 17 decimal digits, either scaled by the other's exponent
+class BigInteger {
+ public:
+  explicit BigInteger(uint64_t value) {
+    words_[0] = static_cast<uint32_t>(value);
+    words_[1] = static_cast<uint32_t>(value >> 32);
+  }
+
+  void multiplyPow5(int exponent) {
+    // 5^13 is the largest power of 5 in a word
+    for (; exponent >= 13; exponent -= 13) {
+      multiply(1220703125);
+    }
+    uint32_t factor = 1;
+    for (; exponent > 0; exponent--) {
+      factor *= 5;
+    }
+    multiply(factor);
+  }
+
+  void shiftLeft(int bits) {
+    const auto words = bits / 32;
+    const auto shift = bits % 32;
+    for (int i = kWords - 1; i >= 0; i--) {
+      const auto from = i - words;
+      uint32_t word = from >= 0 ? words_[from] << shift : 0;
+      if (shift != 0 && from >= 1)
+        word |= words_[from - 1] >> (32 - shift);
+      words_[i] = word;
+    }
+  }
+
+  // Negative, 0 or positive as `*this` is below, equal to or above `rhs`
+  int compare(const BigInteger& rhs) const {
+    for (int i = kWords - 1; i >= 0; i--) {
+      if (words_[i] != rhs.words_[i])
+        return words_[i] < rhs.words_[i] ? -1 : 1;
+    }
+    return 0;
+  }
+
+ private:
+  static constexpr int kWords = 32;
+
+  void multiply(uint32_t factor) {
+    uint64_t carry = 0;
+    for (int i = 0; i < kWords; i++) {
+      carry += static_cast<uint64_t>(words_[i]) * factor;
+      words_[i] = static_cast<uint32_t>(carry);
+      carry >>= 32;
+    }
+  }
+
+  uint32_t words_[kWords]{};
+};  // class BigInteger
+
+// Compares |value| with the decimal digits exactly
+int CompareExact(double value, const DecimalFloat& decimal) {
+  const auto bits = __builtin_bit_cast(uint64_t, value);
+  const auto biased = static_cast<int>((bits >> 52) & 0x7FF);
+  const auto significand = bits & kSignificandMask;
+  // significand * 2^binary against digits * 10^power
+  auto binary = biased != 0 ? biased - kExponentBias : 1 - kExponentBias;
+  uint64_t digits = 0;
+  for (int i = 0; i < decimal.length; i++) {
+    digits = digits * 10 + static_cast<uint64_t>(decimal.digits[i] - '0');
+  }
+  const auto power = decimal.point - decimal.length;
+  BigInteger lhs{biased != 0 ? significand | kHiddenBit : significand};
+  BigInteger rhs{digits};
+  if (power >= 0) {
+    rhs.multiplyPow5(power);
+  } else {
+    lhs.multiplyPow5(-power);
+  }
+  if (binary > power) {
+    lhs.shiftLeft(binary - power);
+  } else {
+    rhs.shiftLeft(power - binary);
+  }
+  return lhs.compare(rhs);
+}
+}  // namespace
+
+DecimalFloat rtk::ShortestDecimal(double value) {
+  const auto bits = __builtin_bit_cast(uint64_t, value);
+  DecimalFloat decimal{};
+  decimal.negative = (bits >> 63) != 0;
+  const auto biased = static_cast<int>((bits >> 52) & 0x7FF);
+  const auto significand = bits & kSignificandMask;
+  if (biased == 0 && significand == 0) {
+    decimal.digits[0] = '0';
+    decimal.length = 1;
+    decimal.point = 1;
+    return decimal;
+  }
+
+  const DiyFp v = biased != 0
+                      ? DiyFp{significand | kHiddenBit, biased - kExponentBias}
+                      : DiyFp{significand, 1 - kExponentBias};
+  // The boundaries halfway to the neighbouring doubles. The one below is
+  // closer when `v` is the first of a binade.
+  const auto high = DiyFp{(v.f << 1) + 1, v.e - 1}.normalize();
+  auto low = significand == 0 && biased > 1 ? DiyFp{(v.f << 2) - 1, v.e - 2}
+                                            : DiyFp{(v.f << 1) - 1, v.e - 1};
+  low.f <<= low.e - high.e;
+  low.e = high.e;
+
+  int k = 0;
+  const auto power = CachedPower(high.e, k);
+  const auto w = v.normalize() * power;
+  auto scaledHigh = high * power;
+  auto scaledLow = low * power;
+  scaledHigh.f--;
+  scaledLow.f++;
+  GenerateDigits(w, scaledHigh, scaledHigh.f - scaledLow.f, decimal.digits,
+                 decimal.length, k);
+  decimal.point = decimal.length + k;
+  while (decimal.length > 1 && decimal.digits[decimal.length - 1] == '0') {
+    decimal.length--;
+  }
+  return decimal;
+}
+
+double rtk::ExtendedToDouble(const void* extended) {
+  const auto bytes = static_cast<const uint8_t*>(extended);
+  uint64_t mantissa = 0;
+  for (int i = 7; i >= 0; i--) {
+    mantissa = (mantissa << 8) | bytes[i];
+  }
+  const auto top = static_cast<unsigned>(bytes[8] | (bytes[9] << 8));
+  const auto sign = static_cast<uint64_t>(top >> 15) << 63;
+  const auto biased = static_cast<int>(top & 0x7FFF);
+
+  if (biased == 0x7FFF) {
+    // Infinity, or a NaN keeping the top of its payload
+    const auto payload = (mantissa << 1) >> 12;
+    return __builtin_bit_cast(double, sign | (uint64_t{0x7FF} << 52) |
+                                          (payload != 0 ? payload | 1 : 0));
+  }
+  if (mantissa == 0)
+    return __builtin_bit_cast(double, sign);
+
+  // The explicit integer bit may be clear in denormals
+  const auto shift = __builtin_clzll(mantissa);
+  mantissa <<= shift;
+  auto exponent = (biased != 0 ? biased : 1) - 16383 - shift + 1023;
+  if (exponent >= 0x7FF)
+    return __builtin_bit_cast(double, sign | (uint64_t{0x7FF} << 52));
+
+  // Keep 53 bits, or fewer for a subnormal, rounding half to even
+  const auto drop = exponent >= 1 ? 11 : 11 + 1 - exponent;
+  if (drop > 64)
+    return __builtin_bit_cast(double, sign);
+  const auto kept = drop == 64 ? 0 : mantissa >> drop;
+  const auto rest =
+      drop == 64 ? mantissa : mantissa & ((uint64_t{1} << drop) - 1);
+  const auto half = uint64_t{1} << (drop - 1);
+  auto result = kept + (rest > half || (rest == half && (kept & 1) != 0));
+  if (exponent >= 1) {
+    // Carrying out of the 53 bits moves up a binade, maybe to infinity
+    result = (static_cast<uint64_t>(exponent - 1) << 52) + result;
+  }
+  // Subnormals carry into the smallest normal on their own
+  return __builtin_bit_cast(double, sign | result);
+}
+
+void rtk::RoundDecimal(DecimalFloat& decimal, double value, int keep) {
+  if (keep >= decimal.length)
+    return;
+  auto up = false;
+  if (keep >= 0) {
+    const auto next = decimal.digits[keep];
+    if (next != '5' || keep + 1 < decimal.length) {
+      up = next >= '5';
+    } else {
+      // A tie on the digits; the binary value may lie either side of it
+      const auto exact = CompareExact(value, decimal);
+      up = exact > 0 ||
+           (exact == 0 && keep > 0 && (decimal.digits[keep - 1] - '0') % 2);
+    }
+  }
+  decimal.length = keep > 0 ? keep : 0;
+  if (up) {
+    auto i = decimal.length - 1;
+    while (i >= 0 && decimal.digits[i] == '9') {
+      i--;
+    }
+    if (i >= 0) {
+      decimal.digits[i]++;
+      decimal.length = i + 1;
+    } else {
+      // All 9s, or nothing kept: a power of ten
+      decimal.digits[0] = '1';
+      decimal.length = 1;
+      decimal.point++;
+    }
+  }
+  while (decimal.length > 0 && decimal.digits[decimal.length - 1] == '0') {
+    decimal.length--;
+  }
+  if (decimal.length == 0) {
+    decimal.digits[0] = '0';
+    decimal.length = 1;
+    decimal.point = 1;
+  }
+}
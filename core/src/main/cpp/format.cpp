@@ -1,6 +1,8 @@
 #include "core/format.h"
 #include <stdarg.h>
 #include <stdint.h>
+#include "core/compiled_format.h"
+#include "core/float_format.h"
 using namespace rtk;
 void Formatter::parsef(const char* format, ...) const {
   va_list arglist;
@@ -23,10 +25,12 @@ void Formatter::vparsef(const char* format, va_list arglist) const {
 
   while (*c_) {
     if (*c_ != '%') {
-      // Just print the character.
-      // Make a string to print
-      char c[]{*(c_++), '\0'};
-      outputChars(c);
+      // Print everything up to the next conversion at once
+      const auto run = c_;
+      while (*c_ && *c_ != '%') {
+        c_++;
+      }
+      outputChars(run, static_cast<size_t>(c_ - run));
     } else {
       c_++;
       parseFlags();
@@ -92,14 +96,36 @@ void Formatter::vparsef(const char* format, va_list arglist) const {
           break;
         case 'f':
           // Decimal floating point, lowercase
+        case 'F':
+          // Decimal floating point, uppercase
         case 'e':
           // Scientific notation (mantissa/exponent), lowercase
         case 'E':
           // Scientific notation (mantissa/exponent), uppercase
         case 'g':
           // Use shortest representation: %e or %f
-        case 'G':
+        case 'G': {
           // Use shortest representation: %E or %F
+          double value;
+          if (size_ == sizeof(long double)) {
+#if __STDC_HOSTED__
+            // Copying the argument out goes through the x87
+            long double extended = va_arg(arglist, long double);
+            value = ExtendedToDouble(&extended);
+#else
+            // Freestanding code stays off the x87, which copying the
+            // argument out would use; skipping it doesn't
+            va_arg(arglist, long double);
+            c_++;
+            outputChars("?");
+            break;
+#endif
+          } else {
+            value = va_arg(arglist, double);
+          }
+          outputFloat(value, *(c_++));
+          break;
+        }
         case 'a':
           // Hex floating point, lowercase
         case 'A':
@@ -112,7 +138,7 @@ void Formatter::vparsef(const char* format, va_list arglist) const {
               break;
             default:  // double
               va_arg(arglist, double);
-              // Don't do anything with it; floating point unsupported.
+              // Don't do anything with it; hex floating point unsupported.
               break;
           }
           outputChars("?");
@@ -129,8 +155,7 @@ void Formatter::vparsef(const char* format, va_list arglist) const {
             }
             default:  // char
               char c = static_cast<char>(va_arg(arglist, uint32_t));
-              char chrs[2]{c, '\0'};
-              outputChars(chrs);
+              outputChars(&c, 1);
               break;
           }
           break;
@@ -186,7 +211,7 @@ void Formatter::vparsef(const char* format, va_list arglist) const {
 
         case '%':
           // Escape for %
-          outputChars(c_++);
+          outputChars(c_++, 1);
           break;
 
         default:
@@ -245,12 +270,13 @@ int Formatter::parseWidth() const {
 }
 
 void Formatter::parsePrecision() const {
-  precision_ = 0;
+  precision_ = -1;
   if (*c_ != '.') {
     return;
   }
   c_++;
 
+  precision_ = 0;
   while (*c_ >= '0' && *c_ <= '9') {
     precision_ = precision_ * 10 + (*c_ - '0');
     c_++;
@@ -302,11 +328,9 @@ void Formatter::parseLength() const {
 void Formatter::outputNumber(uintmax_t val, bool isSigned, bool upper,
                              int base) const {
 
-  constexpr auto buffer_chrs = 20;
-  char buffer[buffer_chrs + 1]{};
-  char* str = buffer + buffer_chrs;
+  char buffer[24];  // 22 octal digits for 64 bits
   int digits = 0;
-  auto fillch = hasFlag(FormatFlags::Zero) ? "0" : " ";
+  const auto fillch = hasFlag(FormatFlags::Zero) ? '0' : ' ';
 
   // Get the positive value of the number
   // and also track if signs add to the width
@@ -321,16 +345,14 @@ void Formatter::outputNumber(uintmax_t val, bool isSigned, bool upper,
 
   // Get the string for the number portion
   if (base == 16) {
-    if (upper) {
-      outdigits<16, true>(val, digits, str);
-    } else {
-      outdigits<16, false>(val, digits, str);
-    }
+    digits = upper ? todigits<16, true>(val, buffer)
+                   : todigits<16, false>(val, buffer);
   } else if (base == 8) {
-    outdigits<8>(val, digits, str);
+    digits = todigits<8>(val, buffer);
   } else {
-    outdigits<10>(positive, digits, str);
+    digits = todigits<10>(positive, buffer);
   }
+  const auto length = static_cast<size_t>(digits);
   // Print the sign
   if (isSigned && (base == 10)) {
     if (negative < 0) {
@@ -355,19 +377,77 @@ void Formatter::outputNumber(uintmax_t val, bool isSigned, bool upper,
     }
   }
   // Left fill
-  if (!hasFlag(FormatFlags::LeftJustify)) {
-    while (digits < width_) {
-      outputChars(fillch);
-      digits++;
-    }
+  if (!hasFlag(FormatFlags::LeftJustify) && digits < width_) {
+    outputFill(fillch, width_ - digits);
+    digits = width_;
   }
   // Print the number buffer
-  outputChars(str);
+  outputChars(buffer, length);
   // right fill
-  while (digits < width_) {
-    outputChars(fillch);
-    digits++;
+  if (digits < width_) {
+    outputFill(fillch, width_ - digits);
+  }
+}
+
+void Formatter::outputFill(char fill, int count) const {
+  constexpr auto kChunk = 16;
+  static constexpr char zeros[kChunk + 1] = "0000000000000000";
+  static constexpr char spaces[kChunk + 1] = "                ";
+  const auto chunk = fill == '0' ? zeros : spaces;
+  for (; count > kChunk; count -= kChunk) {
+    outputChars(chunk, kChunk);
+  }
+  outputChars(chunk, static_cast<size_t>(count));
+}
+
+void Formatter::outputFloat(double value, char conversion) const {
+  // Renders through the compiled formats' code, a piece at a time
+  class Output : public FormatOutput {
+   public:
+    Output(const Formatter& formatter) : formatter_{formatter} {}
+    void put(const char* chars, size_t length) override {
+      formatter_.outputChars(chars, length);
+    }
+
+   private:
+    const Formatter& formatter_;
+  };  // class Output
+
+  FormatOp op;
+  switch (conversion) {
+    case 'F':
+      op.conversion = FormatConversion::FixedUpper;
+      break;
+    case 'e':
+      op.conversion = FormatConversion::Exponent;
+      break;
+    case 'E':
+      op.conversion = FormatConversion::ExponentUpper;
+      break;
+    case 'g':
+      op.conversion = FormatConversion::General;
+      break;
+    case 'G':
+      op.conversion = FormatConversion::GeneralUpper;
+      break;
+    default:
+      op.conversion = FormatConversion::Fixed;
+      break;
   }
+  if (hasFlag(FormatFlags::LeftJustify) || width_ < 0)
+    op.flags |= FormatOp::kLeft;
+  if (hasFlag(FormatFlags::PlusPrefix))
+    op.flags |= FormatOp::kPlus;
+  if (hasFlag(FormatFlags::Space))
+    op.flags |= FormatOp::kSpace;
+  if (hasFlag(FormatFlags::Hash))
+    op.flags |= FormatOp::kHash;
+  if (hasFlag(FormatFlags::Zero))
+    op.flags |= FormatOp::kZero;
+  op.width = static_cast<uint16_t>(width_ < 0 ? -width_ : width_);
+  op.precision = static_cast<int16_t>(precision_);
+  Output output{*this};
+  RenderFloat(op, value, output);
 }
 
 // void StringFormatter::outputChars(const char* chars, size_t length) const {}
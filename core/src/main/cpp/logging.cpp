@@ -1,7 +1,6 @@
 #include "core/logging.h"
 #include <stdarg.h>
 #include "core/format.h"
-#include "core/stdlib/cstring.h"
 using namespace rtk;
 
 // Printf-style formatter outputting to an ostream
@@ -11,11 +10,9 @@ class OstreamFormatter : public Formatter {
 
  protected:
   // just outputs to an ostream
-  size_t outputChars(const char* chars) const override {
-    auto chrs = rtk::strlen(chars);
-    stream_.write(chars);
-    //charsPrinted_ += chrs;
-    return chrs;
+  size_t outputChars(const char* chars, size_t length) const override {
+    stream_.write(chars, length);
+    return length;
   }
 
  private:
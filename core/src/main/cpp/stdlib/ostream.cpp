@@ -4,6 +4,17 @@
 
 using namespace rtk;
 
+// `count` fill chars, a chunk per write
+static void pad(ostream& stream, char fill, size_t count) {
+  constexpr size_t kChunk = 16;
+  char chunk[kChunk];
+  rtk::memset(chunk, fill, count < kChunk ? count : kChunk);
+  for (; count > kChunk; count -= kChunk) {
+    stream.write(chunk, kChunk);
+  }
+  stream.write(chunk, count);
+}
+
 static inline void out(ostream& stream, uintmax_t value,
                        ios_base::fmtflags flags, size_t width, bool isSigned,
                        bool negative, char fill) {
@@ -15,25 +26,19 @@ static inline void out(ostream& stream, uintmax_t value,
   const auto internal = (flags & ios::internal) != 0;
   const auto showbase = (flags & ios::showbase) != 0;
 
-  constexpr auto buf_chrs = 20;  // 20 is good for 64 bits
-  char buffer[buf_chrs + 1]{/*zeros*/};
-  char* str = buffer + buf_chrs;  // go in reverse
-  auto printed = 0;
+  char buffer[24];  // 22 octal digits for 64 bits
+  int printed;
   if (hex) {
-    if (upper) {
-      outdigits<16, true>(value, printed, str);
-    } else {
-      outdigits<16, false>(value, printed, str);
-    }
+    printed = upper ? todigits<16, true>(value, buffer)
+                    : todigits<16, false>(value, buffer);
   } else if (octal) {
-    outdigits<8>(value, printed, str);
+    printed = todigits<8>(value, buffer);
   } else {
-    outdigits(value, printed, str);
+    printed = todigits(value, buffer);
   }
 
   // Prepare to print
-  const char fillstr[] = {fill,
-                          '\0'};  // string representing the fill character
+  const auto length = static_cast<size_t>(printed);
   if (showsign) {
     printed++;  // include in count before printing padding
   }
@@ -44,10 +49,9 @@ static inline void out(ostream& stream, uintmax_t value,
                    : 0;  // for octal, prepend extra 0 if value itself is not 0
   }
   // pad left
-  if (left) {
-    for (; printed < width; printed++) {
-      stream << (const char*)fillstr;
-    }
+  if (left && printed < width) {
+    pad(stream, fill, width - printed);
+    printed = width;
   }
   // Print sign
   if (showsign) {
@@ -62,16 +66,15 @@ static inline void out(ostream& stream, uintmax_t value,
     }
   }
   // pad internal (e.g. zero pad hex)
-  if (internal) {
-    for (; printed < width; printed++) {
-      stream << (const char*)fillstr;
-    }
+  if (internal && printed < width) {
+    pad(stream, fill, width - printed);
+    printed = width;
   }
   // Print number
-  stream << str;
+  stream.write(buffer, length);
   // pad remaining
-  for (; printed < width; printed++) {
-    stream << (const char*)fillstr;
+  if (printed < width) {
+    pad(stream, fill, width - printed);
   }
 }
 
@@ -0,0 +1,101 @@
+// Times the byte, word and SSE2 versions of the core/stdlib/cstring.h scans
+// against the C library. Build and run with `make benchmark`.
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "core/stdlib/cstring.h"
+
+namespace {
+using rtk::detail::sse2_ops;
+using rtk::detail::word_ops;
+
+volatile size_t sink;
+
+// Nanoseconds per call, best of a few runs
+template <typename Fn>
+double time(Fn fn) {
+  constexpr int kRuns = 5;
+  constexpr int kCalls = 20000;
+  double best = 1e30;
+  for (int run = 0; run < kRuns; run++) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kCalls; i++) {
+      sink = fn();
+    }
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count() / kCalls);
+  }
+  return best;
+}
+
+void row(const char* name, size_t len, double bytes, double words,
+         double sse2, double libc) {
+  std::cout.width(8);
+  std::cout << name;
+  std::cout.width(7);
+  std::cout << len;
+  for (auto ns : {bytes, words, sse2, libc}) {
+    std::cout.width(10);
+    std::cout << ns;
+  }
+  std::cout << "\n";
+}
+}  // namespace
+
+int main() {
+  std::cout.precision(1);
+  std::cout << std::fixed;
+  std::cout << "    func    len   bytes ns  words ns   sse2 ns   libc ns\n";
+  for (size_t len : {7, 32, 100, 1000, 16000}) {
+    // Offset by 3 so nothing starts aligned
+    std::vector<char> a(len + 64, 'x'), b(len + 64, 'x');
+    const auto sa = a.data() + 3, sb = b.data() + 3;
+    sa[len] = sb[len] = '\0';
+
+    row("strlen", len, time([&] { return rtk::detail::byte_strnlen(sa, -1); }),
+        time([&] { return rtk::detail::block_strlen<word_ops>(sa); }),
+        time([&] { return rtk::detail::block_strlen<sse2_ops>(sa); }),
+        time([&] { return std::strlen(sa); }));
+    row("strnlen", len,
+        time([&] { return rtk::detail::byte_strnlen(sa, len + 1); }),
+        time([&] { return rtk::detail::block_strnlen<word_ops>(sa, len + 1); }),
+        time([&] { return rtk::detail::block_strnlen<sse2_ops>(sa, len + 1); }),
+        time([&] { return strnlen(sa, len + 1); }));
+    row("memchr", len,
+        time([&] {
+          for (size_t i = 0; i <= len; i++) {
+            if (sa[i] == '\0')
+              return i;
+          }
+          return len;
+        }),
+        time([&] {
+          return (size_t)rtk::detail::block_memchr<word_ops>(sa, 0, len + 1);
+        }),
+        time([&] {
+          return (size_t)rtk::detail::block_memchr<sse2_ops>(sa, 0, len + 1);
+        }),
+        time([&] { return (size_t)std::memchr(sa, 0, len + 1); }));
+    row("strcmp", len,
+        time([&] { return (size_t)rtk::detail::byte_strncmp(sa, sb, -1); }),
+        time([&] {
+          return (size_t)rtk::detail::block_strncmp<word_ops>(sa, sb, -1);
+        }),
+        time([&] {
+          return (size_t)rtk::detail::block_strncmp<sse2_ops>(sa, sb, -1);
+        }),
+        time([&] { return (size_t)std::strcmp(sa, sb); }));
+    row("memcmp", len,
+        time([&] { return (size_t)rtk::detail::byte_strncmp(sa, sb, len); }),
+        time([&] {
+          return (size_t)rtk::detail::block_memcmp<word_ops>(sa, sb, len);
+        }),
+        time([&] {
+          return (size_t)rtk::detail::block_memcmp<sse2_ops>(sa, sb, len);
+        }),
+        time([&] { return (size_t)std::memcmp(sa, sb, len); }));
+  }
+  return 0;
+}
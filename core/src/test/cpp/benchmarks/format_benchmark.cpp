@@ -0,0 +1,85 @@
+// Times core/format.h's integer conversion against a digit-at-a-time loop
+// and the C library's snprintf. Build and run with `make benchmark`.
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include "core/format.h"
+
+namespace {
+volatile int sink;
+char out[32];
+
+// One division per digit into the end of a buffer, as conversion used to go
+template <int base>
+int digitwise(uintmax_t value, char* buffer) {
+  char reversed[24];
+  auto end = reversed + sizeof(reversed);
+  auto start = end;
+  do {
+    const auto rem = value % base;
+    *(--start) = rem < 10 ? '0' + rem : 'a' + (rem - 10);
+    value /= base;
+  } while (value > 0);
+  for (auto p = start; p != end; p++) {
+    *(buffer++) = *p;
+  }
+  return static_cast<int>(end - start);
+}
+
+// Nanoseconds per call, best of a few runs
+template <typename Fn>
+double time(Fn fn) {
+  constexpr int kRuns = 5;
+  constexpr int kCalls = 200000;
+  double best = 1e30;
+  for (int run = 0; run < kRuns; run++) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kCalls; i++) {
+      sink = fn();
+    }
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count() / kCalls);
+  }
+  return best;
+}
+
+void row(const char* name, uintmax_t value, double digitwise, double ours,
+         double libc) {
+  std::cout.width(6);
+  std::cout << name;
+  std::cout.width(22);
+  std::cout << value;
+  for (auto ns : {digitwise, ours, libc}) {
+    std::cout.width(12);
+    std::cout << ns;
+  }
+  std::cout << "\n";
+}
+}  // namespace
+
+int main() {
+  std::cout.precision(1);
+  std::cout << std::fixed;
+  std::cout << "  conv                 value  digits ns  rtk ns      "
+               "snprintf ns\n";
+  // A count, a page address and the extremes
+  for (uintmax_t value : {7ULL, 4096ULL, 123456789ULL, 0xffff800000001000ULL,
+                          18446744073709551615ULL}) {
+    volatile uintmax_t input = value;
+    row("%lu", value, time([&] { return digitwise<10>(input, out); }),
+        time([&] { return rtk::todigits<10>(input, out); }),
+        time([&] {
+          return snprintf(out, sizeof(out), "%lu",
+                          static_cast<unsigned long>(input));
+        }));
+    row("%lx", value, time([&] { return digitwise<16>(input, out); }),
+        time([&] { return rtk::todigits<16>(input, out); }),
+        time([&] {
+          return snprintf(out, sizeof(out), "%lx",
+                          static_cast<unsigned long>(input));
+        }));
+  }
+  return 0;
+}
@@ -9,6 +9,9 @@ extern void stdlib_string_tests();
 extern void stdlib_vector_tests();
 extern void stdlib_ostream_tests();
 extern void core_logging_tests();
+extern void core_compiled_format_tests();
+extern void core_object_cache_tests();
+extern void core_arena_tests();
 
 bool testk::test_logging = true;
 int testk::successful_tests = 0;
@@ -33,6 +36,12 @@ void succeeding_tests() {
   stdlib_ostream_tests();
   std::cout << "\n" << coretestsrc << "logging_tests.cpp\n";
   core_logging_tests();
+  std::cout << "\n" << coretestsrc << "compiled_format_tests.cpp\n";
+  core_compiled_format_tests();
+  std::cout << "\n" << coretestsrc << "object_cache_tests.cpp\n";
+  core_object_cache_tests();
+  std::cout << "\n" << coretestsrc << "arena_tests.cpp\n";
+  core_arena_tests();
 }
 
 int main(int argc, const char** argv) {
@@ -0,0 +1,106 @@
+#include "core/arena.h"
+#include "test/test.h"
+
+// Counts what the arena takes from the heap
+class counting_resource final : public rtk::memory_resource {
+ public:
+  void* allocate(size_t bytes, size_t alignment) override {
+    allocated++;
+    return rtk::heap_resource().allocate(bytes, alignment);
+  }
+  void deallocate(void* ptr, size_t bytes, size_t alignment) override {
+    freed++;
+    rtk::heap_resource().deallocate(ptr, bytes, alignment);
+  }
+  int allocated = 0;
+  int freed = 0;
+};
+
+int test_arena_bump_alignment() {
+  rtk::Arena arena;
+  auto a = static_cast<char*>(arena.allocate(1, 1));
+  auto b = static_cast<char*>(arena.allocate(1, 1));
+  EXPECT_NONNULL(a);
+  EXPECT_EQUAL(b, a + 1);
+  for (size_t alignment = 2; alignment <= 64; alignment *= 2) {
+    auto ptr = arena.allocate(3, alignment);
+    EXPECT_NONNULL(ptr);
+    EXPECT_EQUAL(reinterpret_cast<uintptr_t>(ptr) % alignment, 0U);
+  }
+  return 0;
+}
+
+int test_arena_mark_rewind() {
+  counting_resource upstream;
+  {
+    rtk::Arena arena{upstream, 256};
+    auto first = arena.allocate(16, 16);
+    const auto mark = arena.mark();
+    auto second = arena.allocate(16, 16);
+    for (int i = 0; i < 100; i++) {
+      EXPECT_NONNULL(arena.allocate(64, 8));  // spills into new chunks
+    }
+    EXPECT_TRUE(upstream.allocated > 1);
+
+    arena.rewind(mark);
+    EXPECT_EQUAL(upstream.freed, upstream.allocated - 1);
+    EXPECT_EQUAL(arena.allocate(16, 16), second);
+    EXPECT_NOT_EQUAL(first, second);
+  }
+  EXPECT_EQUAL(upstream.freed, upstream.allocated);
+  return 0;
+}
+
+int test_arena_scope() {
+  rtk::Arena arena;
+  arena.allocate(8, 8);
+  void* inner;
+  {
+    rtk::Arena::Scope scope{arena};
+    inner = arena.allocate(32, 8);
+    arena.allocate(32, 8);
+  }
+  EXPECT_EQUAL(arena.allocate(32, 8), inner);
+  return 0;
+}
+
+int test_arena_oversized() {
+  counting_resource upstream;
+  rtk::Arena arena{upstream, 256};
+  auto big = static_cast<char*>(arena.allocate(4096, 64));
+  EXPECT_NONNULL(big);
+  EXPECT_EQUAL(reinterpret_cast<uintptr_t>(big) % 64, 0U);
+  big[4095] = 1;
+  EXPECT_EQUAL(upstream.allocated, 1);
+  EXPECT_TRUE(arena.allocate(SIZE_MAX - 8, 16) == nullptr);
+  return 0;
+}
+
+int test_arena_initial_buffer() {
+  counting_resource upstream;
+  alignas(16) static char buffer[512];
+  {
+    rtk::Arena arena{buffer, sizeof(buffer), upstream};
+    auto ptr = static_cast<char*>(arena.allocate(64, 8));
+    EXPECT_TRUE(ptr > buffer && ptr < buffer + sizeof(buffer));
+    EXPECT_EQUAL(upstream.allocated, 0);
+
+    EXPECT_NONNULL(arena.allocate(1024, 8));
+    EXPECT_EQUAL(upstream.allocated, 1);
+
+    // Back to the buffer, which stays
+    arena.reset();
+    EXPECT_EQUAL(upstream.freed, 1);
+    EXPECT_EQUAL(arena.allocate(64, 8), ptr);
+  }
+  EXPECT_EQUAL(upstream.freed, 1);
+  return 0;
+}
+
+void core_arena_tests() {
+  TEST(test_arena_bump_alignment);
+  TEST(test_arena_mark_rewind);
+  TEST(test_arena_scope);
+  TEST(test_arena_oversized);
+  TEST(test_arena_initial_buffer);
+}
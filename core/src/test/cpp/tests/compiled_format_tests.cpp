@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include "core/compiled_format.h"
+#include "core/stdlib/sstream.h"
+#include "test/test.h"
+
+using rtk::detail::ArgsMatch;
+using rtk::detail::ParseFormat;
+
+// What doesn't compile, checked on the parser itself
+static_assert(ParseFormat<3>("a%db").count == 3);
+static_assert(ParseFormat<1>("%08lx").ops[0].width == 8);
+static_assert(!ParseFormat<1>("%n").valid);
+static_assert(!ParseFormat<1>("%*d").valid);
+static_assert(!ParseFormat<1>("%a").valid);
+static_assert(!ParseFormat<1>("%").valid);
+static_assert(ArgsMatch<int, const char*>(ParseFormat<2>("%d%s")));
+static_assert(ArgsMatch<char[4]>(ParseFormat<1>("%s")));
+static_assert(!ArgsMatch<const char*>(ParseFormat<1>("%d")));
+static_assert(!ArgsMatch<int>(ParseFormat<1>("%s")));
+static_assert(!ArgsMatch<bool>(ParseFormat<1>("%d")));
+static_assert(ArgsMatch<const void*>(ParseFormat<1>("%p")));
+static_assert(ArgsMatch<double, float>(ParseFormat<2>("%.3f%Lg")));
+static_assert(!ArgsMatch<int>(ParseFormat<1>("%g")));
+static_assert(!ArgsMatch<double>(ParseFormat<1>("%d")));
+
+#define EXPECT_SNPRINTF(format, ...)                                      \
+  do {                                                                    \
+    char ours[128];                                                       \
+    char theirs[128];                                                     \
+    const auto length =                                                   \
+        rtk::FormatTo(ours, sizeof(ours), FMT(format), __VA_ARGS__);      \
+    const auto expected = snprintf(theirs, sizeof(theirs), format,        \
+                                   __VA_ARGS__);                          \
+    EXPECT_EQUAL(static_cast<const char*>(ours),                          \
+                 static_cast<const char*>(theirs));                       \
+    EXPECT_EQUAL(length, static_cast<size_t>(expected));                  \
+  } while (0)
+
+int test_compiled_format_integers() {
+  EXPECT_SNPRINTF("%d|%i|%u", -42, 7, 42U);
+  EXPECT_SNPRINTF("%5d|%-5d|%05d|%+d|% d", -42, -42, -42, 42, 42);
+  EXPECT_SNPRINTF("%x|%X|%#x|%#X|%#010x|%#x", 0xbeefU, 0xbeefU, 0xbeefU,
+                  0xbeefU, 0xbeefU, 0U);
+  EXPECT_SNPRINTF("%o|%#o|%#o|%#.0o", 8U, 8U, 0U, 0U);
+  EXPECT_SNPRINTF("%.5d|%8.3d|%-8.3x|%.0d|%08.3d", 42, -42, 0xaU, 0, 42);
+  EXPECT_SNPRINTF("%ld|%lu|%lx", INT64_MIN, UINT64_MAX, UINT64_MAX);
+  EXPECT_SNPRINTF("%hhu|%hx|%hd", 0x1ffU, 0x12345U, 0x18000);
+  EXPECT_SNPRINTF("%x|%u", -1, -1);
+  EXPECT_SNPRINTF("[%40d]", 7);
+  return 0;
+}
+
+int test_compiled_format_text() {
+  EXPECT_SNPRINTF("%s, %s!", "Hello", "world");
+  EXPECT_SNPRINTF("[%8s|%-8s|%.3s|%5.2s]", "abc", "abc", "abcdef", "abc");
+  EXPECT_SNPRINTF("%c%c%3c|%-3c|", 'o', 'k', 'x', 'y');
+  EXPECT_SNPRINTF("100%% %s", "done");
+
+  char line[32];
+  const rtk::string_view view{"abcdef", 3};
+  EXPECT_EQUAL(rtk::FormatTo(line, sizeof(line), FMT("<%s>"), view), 5UL);
+  EXPECT_EQUAL(static_cast<const char*>(line), "<abc>");
+  return 0;
+}
+
+int test_compiled_format_arguments() {
+  char line[32];
+  // Arguments print at their own width
+  EXPECT_EQUAL(rtk::FormatTo(line, sizeof(line), FMT("%d"), INT64_MIN),
+               20UL);
+  EXPECT_EQUAL(static_cast<const char*>(line), "-9223372036854775808");
+  rtk::FormatTo(line, sizeof(line), FMT("%x"), uint64_t{0x987654321abcdef0});
+  EXPECT_EQUAL(static_cast<const char*>(line), "987654321abcdef0");
+  // Unless a length modifier narrows them
+  rtk::FormatTo(line, sizeof(line), FMT("%hx"), uint64_t{0x987654321abcdef0});
+  EXPECT_EQUAL(static_cast<const char*>(line), "def0");
+  // Pointers, and addresses held as integers
+  auto ptr = reinterpret_cast<const void*>(0xffff800000001000);
+  rtk::FormatTo(line, sizeof(line), FMT("%p %p"), ptr, uintptr_t{0x1000});
+  EXPECT_EQUAL(static_cast<const char*>(line), "ffff800000001000 1000");
+  // No arguments at all
+  rtk::FormatTo(line, sizeof(line), FMT("plain"));
+  EXPECT_EQUAL(static_cast<const char*>(line), "plain");
+  return 0;
+}
+
+int test_compiled_format_truncation() {
+  char line[8];
+  EXPECT_EQUAL(
+      rtk::FormatTo(line, sizeof(line), FMT("%s=%u"), "length", 12345U),
+      12UL);
+  EXPECT_EQUAL(static_cast<const char*>(line), "length=");
+
+  line[0] = 'x';
+  EXPECT_EQUAL(rtk::FormatTo(line, 0, FMT("%d"), 1), 1UL);
+  EXPECT_EQUAL(line[0], 'x');
+  return 0;
+}
+
+int test_compiled_format_stream() {
+  rtk::ostringstream stream;
+  rtk::FormatTo(stream, FMT("[%-6s] %#06x\n"), "page", 0x1aU);
+  EXPECT_EQUAL(rtk::as_const(stream.str()).c_str(), "[page  ] 0x001a\n");
+  return 0;
+}
+
+int test_compiled_format_floats() {
+  EXPECT_SNPRINTF("%f|%f|%f|%f", 0.0, -0.0, 1.0, 0.1);
+  EXPECT_SNPRINTF("%.2f|%.0f|%.0f|%.0f|%#.0f", 3.14159, 0.5, 1.5, 2.5, 2.0);
+  EXPECT_SNPRINTF("%.3f|%.10f|%.1f", 123456.789, 1.0 / 3, 99.96);
+  EXPECT_SNPRINTF("%.2f|%.2f|%.20f", -0.001, 1e-10, 1e-5);
+  EXPECT_SNPRINTF("%e|%E|%.3e|%.0e|%#.0e", 1234.5678, 1e-300, 6.02214076e23,
+                  5e10, 3.0);
+  EXPECT_SNPRINTF("%e|%.15e|%.0e", 2.2250738585072014e-308,
+                  1.7976931348623157e308, 4.9406564584124654e-324);
+  EXPECT_SNPRINTF("%g|%g|%g|%g|%g|%g", 0.0, 100.0, 0.0001, 0.00001, 123456.0,
+                  1234567.0);
+  EXPECT_SNPRINTF("%.3g|%.10g|%G|%#g|%.0g|%g", 3.14159, 1.0 / 3, 1e-20, 1.5,
+                  0.25, 1e100);
+  EXPECT_SNPRINTF("[%10.2f|%-10.2f|%010.2f|%+.1f|% .1f|%+08.2e]", 3.14159,
+                  3.14159, -3.14159, 2.5, 2.25, 12.5);
+  EXPECT_SNPRINTF("%f|%F|%e|%g|%5f|%-5f|%05f", __builtin_inf(),
+                  __builtin_inf(), -__builtin_inf(), __builtin_nan(""),
+                  __builtin_inf(), __builtin_inf(), -__builtin_inf());
+  EXPECT_SNPRINTF("%f|%.3f|%Lg", 0.1f, 1e15, 1.5L);
+  // Ties on the digits, settled by the binary value either side of them
+  EXPECT_SNPRINTF("%.2f|%.2f|%.6f|%.6f|%.0e|%.0e", 0.125, 0.375, 0.0009835,
+                  0.0025165, 9.5e22, 2.5e-310);
+
+  // Digits beyond the shortest round trip are 0s
+  char line[32];
+  rtk::FormatTo(line, sizeof(line), FMT("%.20f"), 0.1);
+  EXPECT_EQUAL(static_cast<const char*>(line), "0.10000000000000000000");
+  rtk::FormatTo(line, sizeof(line), FMT("%e"), 4.9406564584124654e-324);
+  EXPECT_EQUAL(static_cast<const char*>(line), "5.000000e-324");
+  return 0;
+}
+
+void core_compiled_format_tests() {
+  TEST(test_compiled_format_integers);
+  TEST(test_compiled_format_text);
+  TEST(test_compiled_format_arguments);
+  TEST(test_compiled_format_truncation);
+  TEST(test_compiled_format_stream);
+  TEST(test_compiled_format_floats);
+}
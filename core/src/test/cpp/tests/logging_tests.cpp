@@ -1,4 +1,5 @@
 #include <cstdarg>
+#include <cstdio>
 #include <iostream>
 #include "core/format.h"
 #include "core/logging.h"
@@ -27,17 +28,29 @@ class FakeFormatter : public Formatter {
   FakeFormatter(ostream& stream) : stream_{stream} {}
 
  protected:
-  size_t outputChars(const char* chars) const override {
-    auto chrs = rtk::strlen(chars);
-    stream_.write(chars);
-    //charsPrinted_ += chrs;
-    return chrs;
+  size_t outputChars(const char* chars, size_t length) const override {
+    stream_.write(chars, length);
+    return length;
   }
 
  private:
   rtk::ostream& stream_;
 };
 
+// Counts the writes that reach it
+class CountingStream : public ostringstream {
+ public:
+  using ostream::write;
+  ostream& write(const char* data, size_t length) override {
+    writes_++;
+    return ostringstream::write(data, length);
+  }
+  int writes() const { return writes_; }
+
+ private:
+  int writes_ = 0;
+};  // class CountingStream
+
 class FakeLogger : public Logger {
  public:
   FakeLogger() : Logger(rtk::LogLevel::Debug) {}
@@ -97,10 +110,88 @@ class LoggingTests {
     EXPECT_EQUAL(logger.contents(), "987654321abcdef0");
     return 0;
   }
+  static int core_test_log_format_runs() {
+    CountingStream stream;
+    FakeFormatter formatter{stream};
+    formatter.parsef("Literal text only");
+    EXPECT_EQUAL(stream.writes(), 1);
+
+    stream = {};
+    formatter.parsef("Hello, %s! Number %d, char %c.", "world", 100, 'x');
+    EXPECT_EQUAL(as_const(stream.str()).c_str(),
+                 "Hello, world! Number 100, char x.");
+    EXPECT_EQUAL(stream.writes(), 7);
+
+    stream = {};
+    formatter.parsef("100%% done");
+    EXPECT_EQUAL(as_const(stream.str()).c_str(), "100% done");
+
+    stream = {};
+    formatter.parsef("[%40d]", 7);
+    EXPECT_EQUAL(as_const(stream.str()).c_str(),
+                 "[                                       7]");
+    EXPECT_EQUAL(stream.writes(), 6);
+    return 0;
+  }
+  static int core_test_log_format_floats() {
+    CountingStream stream;
+    FakeFormatter formatter{stream};
+    formatter.parsef("%.2f %g %e|%-8.1f|%08.3f|%Lg", 3.14159, 0.5, 1e-300,
+                     2.25, -1.5, 1e100L);
+    EXPECT_EQUAL(as_const(stream.str()).c_str(),
+                 "3.14 0.5 1.000000e-300|2.2     |-001.500|1e+100");
+    return 0;
+  }
+  static int core_test_format_digits() {
+    // Both sides of every power of 10 and 2, and then some
+    uint64_t values[200]{0, UINT64_MAX};
+    size_t count = 2;
+    for (auto power : detail::kPowersOf10) {
+      values[count++] = power;
+      values[count++] = power - 1;
+    }
+    for (int shift = 0; shift < 64; shift++) {
+      values[count++] = uint64_t{1} << shift;
+      values[count++] = 0x9E3779B97F4A7C15ULL >> shift;
+    }
+    for (size_t i = 0; i < count; i++) {
+      const auto value = values[i];
+      char ours[32]{};
+      char theirs[32];
+      ours[todigits<10>(value, ours)] = '\0';
+      snprintf(theirs, sizeof(theirs), "%llu", (unsigned long long)value);
+      EXPECT_EQUAL(static_cast<const char*>(ours),
+                   static_cast<const char*>(theirs));
+      EXPECT_EQUAL(countdigits<10>(value), static_cast<int>(strlen(theirs)));
+
+      ours[todigits<16, false>(value, ours)] = '\0';
+      snprintf(theirs, sizeof(theirs), "%llx", (unsigned long long)value);
+      EXPECT_EQUAL(static_cast<const char*>(ours),
+                   static_cast<const char*>(theirs));
+
+      ours[todigits<16, true>(value, ours)] = '\0';
+      snprintf(theirs, sizeof(theirs), "%llX", (unsigned long long)value);
+      EXPECT_EQUAL(static_cast<const char*>(ours),
+                   static_cast<const char*>(theirs));
+
+      ours[todigits<8>(value, ours)] = '\0';
+      snprintf(theirs, sizeof(theirs), "%llo", (unsigned long long)value);
+      EXPECT_EQUAL(static_cast<const char*>(ours),
+                   static_cast<const char*>(theirs));
+    }
+
+    FakeLogger logger;
+    logger.debug("%o %llo", 8, 01777777777777777777777ULL);
+    EXPECT_EQUAL(logger.contents(), "10 1777777777777777777777");
+    return 0;
+  }
   static void core_logging_tests() {
     TEST(core_test_log_levels);
     TEST(core_test_log_stream);
     TEST(core_test_log_format);
+    TEST(core_test_log_format_runs);
+    TEST(core_test_log_format_floats);
+    TEST(core_test_format_digits);
   }
 
 };  // class LoggingTests
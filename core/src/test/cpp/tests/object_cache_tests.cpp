@@ -0,0 +1,105 @@
+#include "core/object_cache.h"
+#include "core/stdlib/memory.h"
+#include "test/test.h"
+
+static int constructed = 0;
+static int destructed = 0;
+
+class expensive {
+ public:
+  expensive() : value{42} { constructed++; }
+  ~expensive() { destructed++; }
+  int value;
+};
+
+class cached : public rtk::DynamicPlacement<cached> {
+ public:
+  int uses = 0;
+};
+
+int test_object_cache_retains_construction() {
+  constructed = destructed = 0;
+  {
+    rtk::ObjectCache<expensive> cache;
+    auto a = cache.allocate();
+    EXPECT_NONNULL(a);
+    EXPECT_EQUAL(a->value, 42);
+    const auto built = constructed;
+    EXPECT_EQUAL(built, (int)cache.capacity());
+
+    a->value = 7;  // state survives the round trip
+    cache.free(a);
+    auto b = cache.allocate();
+    EXPECT_EQUAL(b, a);
+    EXPECT_EQUAL(b->value, 7);
+    EXPECT_EQUAL(constructed, built);
+    EXPECT_EQUAL(destructed, 0);
+    cache.free(b);
+  }
+  EXPECT_EQUAL(destructed, constructed);
+  return 0;
+}
+
+int test_object_cache_alignment() {
+  rtk::ObjectCache<expensive> cache;
+  expensive* objects[100];
+  for (auto& obj : objects) {
+    obj = cache.allocate();
+    EXPECT_NONNULL(obj);
+    EXPECT_EQUAL(reinterpret_cast<uintptr_t>(obj) % 64, 0U);
+  }
+  for (size_t i = 1; i < 100; i++) {
+    EXPECT_NOT_EQUAL(objects[i], objects[i - 1]);
+  }
+  for (auto obj : objects) {
+    cache.free(obj);
+  }
+  return 0;
+}
+
+int test_object_cache_reap() {
+  constructed = destructed = 0;
+  rtk::ObjectCache<expensive> cache;
+  expensive* objects[100];
+  for (auto& obj : objects) {
+    obj = cache.allocate();
+  }
+  const auto slabs = cache.capacity();
+  EXPECT_TRUE(slabs >= 100);
+
+  // One object keeps its slab alive
+  for (size_t i = 1; i < 100; i++) {
+    cache.free(objects[i]);
+  }
+  EXPECT_TRUE(cache.reap() > 0);
+  EXPECT_TRUE(cache.capacity() < slabs);
+  EXPECT_EQUAL(objects[0]->value, 42);
+  cache.free(objects[0]);
+  cache.reap();
+  EXPECT_EQUAL(cache.capacity(), 0U);
+  EXPECT_EQUAL(destructed, constructed);
+  return 0;
+}
+
+int test_object_cache_factory() {
+  rtk::ObjectCache<cached> cache;
+  cached* first;
+  {
+    auto ptr = cached::Factory<>::create_from(cache);
+    EXPECT_NONNULL(ptr.get());
+    first = ptr.get();
+    ptr->uses++;
+  }
+  // Deleting handed it back: same object, still constructed
+  auto again = cached::Factory<>::create_from(cache);
+  EXPECT_EQUAL(again.get(), first);
+  EXPECT_EQUAL(again->uses, 1);
+  return 0;
+}
+
+void core_object_cache_tests() {
+  TEST(test_object_cache_retains_construction);
+  TEST(test_object_cache_alignment);
+  TEST(test_object_cache_reap);
+  TEST(test_object_cache_factory);
+}
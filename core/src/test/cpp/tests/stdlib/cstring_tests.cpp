@@ -92,6 +92,79 @@ int test_strncpy_small() {
   return 0;
 }
 
+int test_strnlen() {
+  EXPECT_0(rtk::strnlen(nullptr, 4));
+  EXPECT_EQUAL(rtk::strnlen("hello", 3), 3);
+  EXPECT_EQUAL(rtk::strnlen("hello", 100), 5);
+  static_assert(rtk::strnlen("hello", 2) == 2);
+  return 0;
+}
+
+int test_memchr() {
+  const char str[] = "hello, world";
+  EXPECT_EQUAL(rtk::memchr(str, 'w', sizeof(str)), str + 7);
+  EXPECT_NULL(rtk::memchr(str, 'w', 7));
+  EXPECT_EQUAL(rtk::memchr(str, '\0', sizeof(str)), str + 12);
+  static_assert(*rtk::memchr("abc", 'c', 3) == 'c');
+  return 0;
+}
+
+int test_strcmp() {
+  EXPECT_0(rtk::strcmp("hello", "hello"));
+  EXPECT_TRUE(rtk::strcmp("hello", "help") < 0);
+  EXPECT_TRUE(rtk::strcmp("hello", "hell") > 0);
+  EXPECT_TRUE(rtk::strcmp("\xff", "a") > 0);  // compared unsigned
+  EXPECT_0(rtk::strcmp(nullptr, ""));
+  EXPECT_0(rtk::strncmp("hello", "help", 3));
+  EXPECT_TRUE(rtk::strncmp("hello", "help", 4) < 0);
+  static_assert(rtk::strcmp("abc", "abd") < 0);
+  return 0;
+}
+
+int test_memcmp() {
+  EXPECT_0(rtk::memcmp("abc\0x", "abc\0y", 4));
+  EXPECT_TRUE(rtk::memcmp("abc\0x", "abc\0y", 5) < 0);
+  const unsigned char a[] = {1, 2, 200}, b[] = {1, 2, 3};
+  EXPECT_TRUE(rtk::memcmp(a, b, sizeof(a)) > 0);
+  static_assert(rtk::memcmp("ab", "ab", 2) == 0);
+  return 0;
+}
+
+// Each block variant against the C library, over alignments and lengths
+template <typename Ops>
+int check_block_variant() {
+  alignas(64) char a[256], b[256];
+  for (size_t offset = 0; offset < 24; offset++) {
+    for (size_t len = 0; len + offset < 200; len++) {
+      std::fill(std::begin(a), std::end(a), 'x');
+      std::fill(std::begin(b), std::end(b), 'x');
+      a[offset + len] = b[offset + len] = '\0';
+      const auto sa = a + offset, sb = b + offset;
+      EXPECT_EQUAL(rtk::detail::block_strlen<Ops>(sa), len);
+      EXPECT_EQUAL(rtk::detail::block_strnlen<Ops>(sa, len / 2), len / 2);
+      EXPECT_EQUAL(rtk::detail::block_memchr<Ops>(sa, '\0', len + 1),
+                   (const void*)(sa + len));
+      EXPECT_NULL(rtk::detail::block_memchr<Ops>(sa, '\0', len));
+      EXPECT_0(rtk::detail::block_strncmp<Ops>(sa, sb, SIZE_MAX));
+      EXPECT_0(rtk::detail::block_memcmp<Ops>(sa, sb, len));
+      if (len > 0) {
+        sb[len - 1] = 'y';
+        EXPECT_TRUE(rtk::detail::block_strncmp<Ops>(sa, sb, SIZE_MAX) < 0);
+        EXPECT_0(rtk::detail::block_strncmp<Ops>(sa, sb, len - 1));
+        EXPECT_TRUE(rtk::detail::block_memcmp<Ops>(sb, sa, len) > 0);
+        EXPECT_0(rtk::detail::block_memcmp<Ops>(sb, sa, len - 1));
+      }
+    }
+  }
+  return 0;
+}
+int test_word_variants() {
+  return check_block_variant<rtk::detail::word_ops>();
+}
+int test_sse2_variants() {
+  return check_block_variant<rtk::detail::sse2_ops>();
+}
+
 void stdlib_cstring_tests() {
   // strlen
   TEST(test_strlen_nulltpr);
@@ -107,4 +180,11 @@ void stdlib_cstring_tests() {
   TEST(test_strncpy_nulls);
   TEST(test_strncpy_overlap);
   TEST(test_strncpy_small);
+  // scans and compares
+  TEST(test_strnlen);
+  TEST(test_memchr);
+  TEST(test_strcmp);
+  TEST(test_memcmp);
+  TEST(test_word_variants);
+  TEST(test_sse2_variants);
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
+#include "core/arena.h"
 #include "core/stdlib/memory.h"
+#include "core/stdlib/memory_resource.h"
 #include "core/stdlib/type_traits.h"  // rtk::is_same
 #include "core/stdlib/utility.h"      // rtk::swap
 #include "test/test.h"
@@ -287,6 +289,22 @@ int test_virtual_delete() {
   return 0;
 }
 
+int test_unique_allocate_from_resource() {
+  static_assert(sizeof(rtk::unique_ptr<int>) == sizeof(int*),
+                "stateless deleters should take no room");
+  rtk::Arena arena;
+  bool deleted;
+  {
+    auto ptr = rtk::allocate_unique<deleteable>(arena, deleted);
+    EXPECT_NONNULL(ptr.get());
+    EXPECT_NOT_EQUAL(arena.mark().used, 0U);
+    auto moved = rtk::move(ptr);
+    EXPECT_FALSE(deleted);
+  }
+  EXPECT_TRUE(deleted);
+  return 0;
+}
+
 void stdlib_memory_tests() {
   TEST(test_unique_default_constructor);
   TEST(test_unique_default);
@@ -307,4 +325,5 @@ void stdlib_memory_tests() {
   // TEST(test_dynamic_delete);
   // TEST(test_unique_array);
   TEST(test_unique_array_deleted);
+  TEST(test_unique_allocate_from_resource);
 }
\ No newline at end of file
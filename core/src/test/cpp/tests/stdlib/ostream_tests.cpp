@@ -1,9 +1,28 @@
+#include "core/stdlib/buffered_ostream.h"
 #include "core/stdlib/iomanip.h"
 #include "core/stdlib/ostream.h"
 #include "core/stdlib/sstream.h"
 #include "test/test.h"
 
 namespace rtk {
+// Records what reaches the sink, and in how many pieces
+class RecordingStream : public buffered_ostream<8> {
+ public:
+  ~RecordingStream() { flush(); }
+  string& sunk() { return sunk_; }
+  int sinks() const { return sinks_; }
+
+ protected:
+  void sink(const char* str, size_t length) override {
+    sunk_.append(string_view{str, length});
+    sinks_++;
+  }
+
+ private:
+  string sunk_;
+  int sinks_ = 0;
+};  // class RecordingStream
+
 class ostream_tests {
  public:
   static int test_sstream() {
@@ -75,9 +94,48 @@ class ostream_tests {
 
     return 0;
   }
+  static int test_ostream_write_length() {
+    ostringstream ss;
+    ss.write("Hello, world!", 5);
+    EXPECT_EQUAL(as_const(ss.str()).c_str(), "Hello");
+
+    ss << setfill('*') << setw(40) << left << 1;
+    EXPECT_EQUAL(as_const(ss.str()).c_str(),
+                 "Hello***************************************1");
+    return 0;
+  }
+  static int test_buffered_ostream() {
+    RecordingStream stream;
+    stream << "abc" << "def";
+    EXPECT_EQUAL(stream.sinks(), 0);
+    EXPECT_EQUAL(stream.pending(), 6UL);
+
+    // Overflowing sinks what was buffered
+    stream << "ghi";
+    EXPECT_EQUAL(stream.sinks(), 1);
+    EXPECT_EQUAL(as_const(stream.sunk()).c_str(), "abcdef");
+    EXPECT_EQUAL(stream.pending(), 3UL);
+
+    // Writes the size of the buffer go straight through
+    stream << "0123456789";
+    EXPECT_EQUAL(stream.sinks(), 3);
+    EXPECT_EQUAL(as_const(stream.sunk()).c_str(), "abcdefghi0123456789");
+    EXPECT_EQUAL(stream.pending(), 0UL);
+
+    stream << "xyz" << flush;
+    EXPECT_EQUAL(stream.sinks(), 4);
+    EXPECT_EQUAL(as_const(stream.sunk()).c_str(), "abcdefghi0123456789xyz");
+
+    // Nothing left to sink
+    stream.flush();
+    EXPECT_EQUAL(stream.sinks(), 4);
+    return 0;
+  }
   static void stdlib_ostream_tests() {
     TEST(test_sstream);
     TEST(test_ostream_hex);
+    TEST(test_ostream_write_length);
+    TEST(test_buffered_ostream);
   }
 };  // class ostream_tests}
 
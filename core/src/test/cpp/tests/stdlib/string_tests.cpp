@@ -1,3 +1,5 @@
+#include "core/arena.h"
+#include "core/stdlib/memory_resource.h"
 #include "core/stdlib/string.h"
 #include "core/stdlib/utility.h"
 #include "test/test.h"
@@ -23,8 +25,8 @@ class string_tests {
     EXPECT_FALSE(abc.is_short_);
     EXPECT_EQUAL(abc.length(), abc.len_);
     EXPECT_EQUAL(abc.len_, kAbcLen);
-    EXPECT_EQUAL((const char*)abc.cstr_.get(), (const char*)abc.c_str());
-    EXPECT_EQUAL((const char*)abc.cstr_.get(), kAbc);
+    EXPECT_EQUAL((const char*)abc.cstr_, (const char*)abc.c_str());
+    EXPECT_EQUAL((const char*)abc.cstr_, kAbc);
     return 0;
   }
   static int test_string_copy_long_to_short() {
@@ -103,6 +105,20 @@ class string_tests {
 #undef B
 #undef C
   };
+  static int test_string_allocator() {
+    using arena_string = basic_string<resource_allocator<char>>;
+    Arena arena;
+    arena_string abc{kAbc, resource_allocator<char>{arena}};
+    EXPECT_FALSE(abc.is_short_);
+    const auto used = arena.mark().used;
+    EXPECT_TRUE(used > kAbcLen);
+    abc.append(kHello);
+    EXPECT_TRUE(arena.mark().used > used);
+    auto copy = abc;
+    EXPECT_EQUAL(&copy.get_allocator().resource(), (memory_resource*)&arena);
+    EXPECT_EQUAL((const char*)copy.c_str(), (const char*)abc.c_str());
+    return 0;
+  }
   static void stdlib_string_tests() {
     TEST(test_string_short);
     TEST(test_string_long);
@@ -112,6 +128,7 @@ class string_tests {
     TEST(test_string_move_long_to_short);
     TEST(test_string_append);
     TEST(test_string_concat_operator);
+    TEST(test_string_allocator);
   }
 };  // class string_tests
 }  // namespace rtk
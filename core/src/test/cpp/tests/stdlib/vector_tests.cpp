@@ -1,7 +1,34 @@
+#include "core/arena.h"
+#include "core/stdlib/memory_resource.h"
+#include "core/stdlib/small_vector.h"
 #include "core/stdlib/vector.h"
 #include "test/test.h"
 
 namespace rtk {
+// Counts live instances, to catch extra constructions and leaks
+class tracked {
+ public:
+  static int live;
+  static int constructed;
+  int value;
+  tracked() : tracked(0) {}
+  tracked(int v) : value{v} {
+    live++;
+    constructed++;
+  }
+  tracked(const tracked& other) : tracked(other.value) {}
+  tracked(tracked&& other) : tracked(other.value) { other.value = -1; }
+  tracked& operator=(const tracked& other) = default;
+  tracked& operator=(tracked&& other) {
+    value = other.value;
+    other.value = -1;
+    return *this;
+  }
+  ~tracked() { live--; }
+};
+int tracked::live = 0;
+int tracked::constructed = 0;
+
 class vector_tests {
  public:
   static int test_stdlib_vector() {
@@ -20,10 +47,10 @@ class vector_tests {
           expected_capacity = expected_capacity * v.num_ / v.denom_;
         }
         EXPECT_EQUAL(v.capacity_, expected_capacity);
-        EXPECT_NOT_EQUAL(v.elems_.get(), vec_ptr);
-        vec_ptr = v.elems_.get();
+        EXPECT_NOT_EQUAL(v.elems_, vec_ptr);
+        vec_ptr = v.elems_;
       } else {
-        EXPECT_EQUAL(v.elems_.get(), vec_ptr);
+        EXPECT_EQUAL(v.elems_, vec_ptr);
       }
     }
     for (auto i = 1; i <= 10; i++) {
@@ -31,7 +58,169 @@ class vector_tests {
     }
     return 0;
   }
-  static void stdlib_vector_tests() { TEST(test_stdlib_vector); }
+  static int test_stdlib_vector_allocator() {
+    static_assert(sizeof(vector<int>) == 4 * sizeof(size_t),
+                  "the heap allocator should take no room");
+    Arena arena;
+    vector<int, resource_allocator<int>> v{resource_allocator<int>{arena}};
+    for (auto i = 0; i < 100; i++) {
+      v.push_back(i);
+    }
+    EXPECT_EQUAL(&v.get_allocator().resource(), (memory_resource*)&arena);
+    for (auto i = 0; i < 100; i++) {
+      EXPECT_EQUAL(v[i], i);
+    }
+    auto moved = move(v);
+    EXPECT_EQUAL(moved.size(), 100U);
+    EXPECT_EQUAL(moved[99], 99);
+    EXPECT_EQUAL(v.size(), 0U);
+    return 0;
+  }
+  static int test_stdlib_vector_constructs_live_only() {
+    tracked::live = tracked::constructed = 0;
+    {
+      vector<tracked> v;
+      v.reserve(100);
+      v.push_back(tracked{1});
+      EXPECT_EQUAL(tracked::live, 1);
+      for (auto i = 2; i <= 50; i++) {
+        v.emplace_back(i);
+      }
+      // Spare capacity holds no objects
+      EXPECT_EQUAL(tracked::live, 50);
+      EXPECT_TRUE(v.capacity() > v.size());
+      v.push_back(v[0]);  // from inside the vector, across a regrowth
+      EXPECT_EQUAL(v.back().value, 1);
+      v.resize(10);
+      EXPECT_EQUAL(tracked::live, 10);
+      v.shrink_to_fit();
+      EXPECT_EQUAL(v.capacity(), 10U);
+      EXPECT_EQUAL(v[9].value, 10);
+    }
+    EXPECT_EQUAL(tracked::live, 0);
+    return 0;
+  }
+  static int test_stdlib_vector_insert_erase() {
+    tracked::live = 0;
+    {
+      vector<tracked> v;
+      for (auto i = 0; i < 5; i++) {
+        v.emplace_back(i * 10);  // 0 10 20 30 40
+      }
+      auto it = v.insert(v.begin() + 2, tracked{15});
+      EXPECT_EQUAL(it->value, 15);
+      v.insert(v.begin(), v[4]);  // 30 0 10 15 20 30 40
+      v.insert(v.end(), tracked{50});
+      const int expected[] = {30, 0, 10, 15, 20, 30, 40, 50};
+      EXPECT_EQUAL(v.size(), 8U);
+      size_t i = 0;
+      for (auto& elem : v) {
+        EXPECT_EQUAL(elem.value, expected[i++]);
+      }
+
+      it = v.erase(v.begin());
+      EXPECT_EQUAL(it->value, 0);
+      it = v.erase(v.begin() + 1, v.begin() + 4);  // 0 30 40 50
+      EXPECT_EQUAL(it->value, 30);
+      EXPECT_EQUAL(v.size(), 4U);
+      EXPECT_EQUAL(tracked::live, 4);
+      EXPECT_EQUAL(v.back().value, 50);
+    }
+    EXPECT_EQUAL(tracked::live, 0);
+    return 0;
+  }
+  static int test_stdlib_vector_trivial() {
+    vector<int> v(3);
+    EXPECT_EQUAL(v[2], 0);
+    for (auto i = 0; i < 1000; i++) {
+      v.push_back(i);
+    }
+    v.erase(v.begin(), v.begin() + 3);
+    int sum = 0;
+    for (auto elem : v) {
+      sum += elem;
+    }
+    EXPECT_EQUAL(sum, 999 * 1000 / 2);
+    // Elements are built with T(args...), so narrowing is allowed
+    double wide = 2.5;
+    v.emplace_back(wide);
+    v.emplace(v.begin(), wide);
+    EXPECT_EQUAL(v.front(), 2);
+    EXPECT_EQUAL(v.back(), 2);
+    v.clear();
+    EXPECT_TRUE(v.empty());
+    v.shrink_to_fit();
+    EXPECT_EQUAL(v.capacity(), 0U);
+    return 0;
+  }
+  static int test_stdlib_small_vector() {
+    tracked::live = 0;
+    {
+      small_vector<tracked, 4> v;
+      EXPECT_EQUAL(v.capacity(), 4U);
+      for (auto i = 0; i < 4; i++) {
+        v.emplace_back(i);
+      }
+      // Still inline
+      EXPECT_TRUE(v.is_inline());
+      EXPECT_EQUAL(tracked::live, 4);
+      v.insert(v.begin(), tracked{-5});  // spills
+      EXPECT_FALSE(v.is_inline());
+      EXPECT_EQUAL(v.size(), 5U);
+      EXPECT_EQUAL(v[0].value, -5);
+      EXPECT_EQUAL(v[4].value, 3);
+      EXPECT_EQUAL(tracked::live, 5);
+
+      // Moving heap storage hands it over
+      auto ptr = v.data();
+      small_vector<tracked, 4> moved{move(v)};
+      EXPECT_EQUAL(moved.data(), ptr);
+      EXPECT_TRUE(v.is_inline());
+      EXPECT_EQUAL(v.size(), 0U);
+
+      moved.erase(moved.begin(), moved.begin() + 2);
+      moved.shrink_to_fit();  // back inline
+      EXPECT_TRUE(moved.is_inline());
+      EXPECT_EQUAL(moved.capacity(), 4U);
+      EXPECT_EQUAL(moved[0].value, 1);
+      EXPECT_EQUAL(moved[2].value, 3);
+      EXPECT_EQUAL(tracked::live, 3);
+
+      // Moving inline storage moves the elements
+      v = move(moved);
+      EXPECT_TRUE(v.is_inline());
+      EXPECT_EQUAL(v.size(), 3U);
+      EXPECT_EQUAL(v[1].value, 2);
+      EXPECT_EQUAL(moved.size(), 0U);
+      EXPECT_EQUAL(tracked::live, 3);
+    }
+    EXPECT_EQUAL(tracked::live, 0);
+    return 0;
+  }
+  static int test_stdlib_small_vector_allocator() {
+    Arena arena;
+    small_vector<int, 8, resource_allocator<int>> v{
+        resource_allocator<int>{arena}};
+    for (auto i = 0; i < 8; i++) {
+      v.push_back(i);
+    }
+    EXPECT_EQUAL(arena.mark().chunk, nullptr);  // nothing drawn yet
+    for (auto i = 8; i < 100; i++) {
+      v.push_back(i);
+    }
+    EXPECT_NOT_EQUAL(arena.mark().chunk, nullptr);
+    EXPECT_EQUAL(v[99], 99);
+    return 0;
+  }
+  static void stdlib_vector_tests() {
+    TEST(test_stdlib_vector);
+    TEST(test_stdlib_vector_allocator);
+    TEST(test_stdlib_vector_constructs_live_only);
+    TEST(test_stdlib_vector_insert_erase);
+    TEST(test_stdlib_vector_trivial);
+    TEST(test_stdlib_small_vector);
+    TEST(test_stdlib_small_vector_allocator);
+  }
 };  // class vector_testsd
 }  // namespace rtk
 
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/stdlib/freestanding/new.h"  // placement new
+#include "core/stdlib/memory_resource.h"
+
+namespace rtk {
+// Bump allocator for short-lived bulk work. Memory comes from a chain of
+// chunks drawn from an upstream resource and is only ever given back all at
+// once: by rewinding to a mark, or when the arena goes away. Objects in it
+// are never destroyed, so keep to trivially destructible ones or destroy
+// them yourself. Not thread-safe.
+class Arena final : public memory_resource {
+ public:
+  static constexpr size_t kDefaultChunkSize = 16 * 1024;
+
+  // Position to rewind() to; everything allocated after it is freed
+  struct Mark {
+    void* chunk;
+    size_t used;
+  };
+
+  // Frees everything allocated in its scope
+  class Scope final {
+   public:
+    explicit Scope(Arena& arena) : arena_{arena}, mark_{arena.mark()} {}
+    ~Scope() { arena_.rewind(mark_); }
+    Scope(const Scope& other) = delete;
+    Scope& operator=(const Scope& other) = delete;
+
+   private:
+    Arena& arena_;
+    const Mark mark_;
+  };  // class Arena::Scope
+
+  explicit Arena(memory_resource& upstream = heap_resource(),
+                 size_t chunkSize = kDefaultChunkSize)
+      : upstream_{upstream}, chunkSize_{chunkSize} {}
+  // Starts out in `buffer` (16-byte aligned), which the arena never frees,
+  // before going upstream, so boot code can use it with no heap at all
+  Arena(void* buffer, size_t size, memory_resource& upstream = heap_resource(),
+        size_t chunkSize = kDefaultChunkSize)
+      : Arena(upstream, chunkSize) {
+    if (size > sizeof(Chunk)) {
+      auto chunk = static_cast<Chunk*>(buffer);
+      *chunk = Chunk{nullptr, size - sizeof(Chunk), 0, false};
+      head_ = chunk;
+    }
+  }
+  Arena(const Arena& other) = delete;
+  Arena& operator=(const Arena& other) = delete;
+  ~Arena() { rewind(Mark{nullptr, 0}); }
+
+  void* allocate(size_t bytes, size_t alignment) override {
+    if (head_ != nullptr) {
+      auto ptr = bump(head_, bytes, alignment);
+      if (ptr != nullptr)
+        return ptr;
+    }
+    if (!grow(bytes, alignment))
+      return nullptr;  // out of mem?
+    return bump(head_, bytes, alignment);
+  }
+  // Freed in bulk; see rewind()
+  void deallocate(void*, size_t, size_t) override {}
+
+  Mark mark() const { return Mark{head_, head_ ? head_->used : 0}; }
+  // Frees everything allocated since `mark`. Chunks added since then go
+  // back upstream.
+  void rewind(Mark mark) {
+    while (head_ != nullptr && head_ != mark.chunk) {
+      auto chunk = head_;
+      head_ = chunk->prev;
+      if (chunk->owned) {
+        upstream_.deallocate(chunk, sizeof(Chunk) + chunk->size,
+                             alignof(Chunk));
+      }
+    }
+    if (head_ != nullptr) {
+      head_->used = mark.used;
+    }
+  }
+  // Frees everything, keeping only a caller's initial buffer
+  void reset() {
+    auto chunk = head_;
+    while (chunk != nullptr && chunk->prev != nullptr) {
+      chunk = chunk->prev;
+    }
+    rewind(Mark{chunk != nullptr && !chunk->owned ? chunk : nullptr, 0});
+  }
+
+ private:
+  // Header at the start of each chunk, followed by its data
+  struct alignas(16) Chunk {
+    Chunk* prev;
+    size_t size;  // data bytes
+    size_t used;
+    bool owned;  // from upstream, not the caller's buffer
+  };
+
+  memory_resource& upstream_;
+  const size_t chunkSize_;
+  Chunk* head_ = nullptr;
+
+  static void* bump(Chunk* chunk, size_t bytes, size_t alignment) {
+    const auto data = reinterpret_cast<uintptr_t>(chunk + 1);
+    const auto start =
+        (data + chunk->used + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    const auto offset = start - data;
+    if (offset > chunk->size || bytes > chunk->size - offset)
+      return nullptr;
+    chunk->used = offset + bytes;
+    return reinterpret_cast<void*>(start);
+  }
+  bool grow(size_t bytes, size_t alignment) {
+    // Oversized requests get a chunk of their own
+    auto size = chunkSize_;
+    if (bytes > SIZE_MAX - sizeof(Chunk) - alignment)
+      return false;
+    if (bytes + alignment > size) {
+      size = bytes + alignment;
+    }
+    auto memory = upstream_.allocate(sizeof(Chunk) + size, alignof(Chunk));
+    if (memory == nullptr)
+      return false;
+    head_ = new (memory) Chunk{head_, size, 0, true};
+    return true;
+  }
+};  // class Arena
+}  // namespace rtk
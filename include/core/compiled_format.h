@@ -0,0 +1,434 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "core/float_format.h"
+#include "core/stdlib/ostream.h"
+#include "core/stdlib/string_view.h"
+
+// Printf-style formats parsed at compile time. Wrap the literal in FMT():
+//
+//   char line[64];
+//   rtk::FormatTo(line, sizeof(line), FMT("page %#lx x%u"), address, count);
+//
+// A malformed format, or an argument that doesn't match its conversion, is
+// a compile error. The conversions are Formatter's less %n, %* and %a,
+// with printf's padding rules. Arguments print at their own width unless
+// a length modifier narrows them, so %d takes an int64_t as is.
+// Formatter::vparsef remains for formats only known at run time.
+#define FMT(format)                                         \
+  [] {                                                      \
+    struct Format {                                         \
+      static constexpr const char* get() { return format; } \
+    };                                                      \
+    return Format{};                                        \
+  }()
+
+namespace rtk {
+enum class FormatConversion : uint8_t {
+  Literal,        // the format's chars [offset, offset + length)
+  Signed,         // d i
+  Unsigned,       // u
+  Octal,          // o
+  Hex,            // x
+  HexUpper,       // X
+  Pointer,        // p, as hex without a prefix
+  Char,           // c
+  String,         // s
+  Fixed,          // f
+  FixedUpper,     // F
+  Exponent,       // e
+  ExponentUpper,  // E
+  General,        // g
+  GeneralUpper,   // G
+};  // enum class FormatConversion
+
+// One piece of a parsed format
+struct FormatOp {
+  static constexpr uint8_t kLeft = 1;
+  static constexpr uint8_t kPlus = 1 << 1;
+  static constexpr uint8_t kSpace = 1 << 2;
+  static constexpr uint8_t kHash = 1 << 3;
+  static constexpr uint8_t kZero = 1 << 4;
+
+  FormatConversion conversion = FormatConversion::Literal;
+  uint8_t flags = 0;
+  uint8_t size = 0;  // from a length modifier, 0 for the argument's own
+  uint16_t width = 0;
+  int16_t precision = -1;  // -1 when there's none
+  uint16_t offset = 0;
+  uint16_t length = 0;
+};  // struct FormatOp
+
+// An argument, with its type erased
+struct FormatArg {
+  uintmax_t value = 0;  // integers zero-extended from `size` bytes
+  double real = 0;
+  const char* str = nullptr;
+  size_t length = 0;
+  uint8_t size = 0;
+  bool isSigned = false;
+};  // struct FormatArg
+
+// Where rendered formats go, a piece at a time
+class FormatOutput {
+ public:
+  virtual void put(const char* chars, size_t length) = 0;
+  void fill(char c, size_t count);
+};  // class FormatOutput
+
+// Keeps what fits in `size` chars, terminator included, like snprintf
+class BufferFormatOutput : public FormatOutput {
+ public:
+  BufferFormatOutput(char* buffer, size_t size)
+      : buffer_{buffer}, size_{size} {}
+  void put(const char* chars, size_t length) override;
+  // Terminates the buffer; returns the length of the whole output
+  size_t finish();
+
+ private:
+  char* buffer_;
+  size_t size_;
+  size_t length_ = 0;
+};  // class BufferFormatOutput
+
+class StreamFormatOutput : public FormatOutput {
+ public:
+  StreamFormatOutput(ostream& stream) : stream_{stream} {}
+  void put(const char* chars, size_t length) override {
+    stream_.write(chars, length);
+  }
+
+ private:
+  ostream& stream_;
+};  // class StreamFormatOutput
+
+void RenderFormat(const char* format, const FormatOp* ops, size_t count,
+                  const FormatArg* args, FormatOutput& out);
+// One of the floating point conversions, printed from the shortest digits
+// that read back as `value` rather than its exact binary expansion: any
+// digits past those are 0s. So %.20f of 0.1 is 0.10000000000000000000 and
+// %e of the smallest subnormal is 5.000000e-324, where printf shows the
+// binary value. Rounding ties are settled against the binary value.
+void RenderFloat(const FormatOp& op, double value, FormatOutput& out);
+
+namespace detail {
+enum class FormatArgKind {
+  None,
+  Signed,
+  Unsigned,
+  Char,
+  String,
+  Pointer,
+  Float
+};
+
+template <typename T>
+struct FormatArgTraits {
+  static constexpr auto kind = FormatArgKind::None;
+};
+template <typename T>
+struct FormatArgTraits<T*> {
+  static constexpr auto kind = FormatArgKind::Pointer;
+};
+// Literals and buffers, which arguments taken by reference don't decay
+template <size_t N>
+struct FormatArgTraits<char[N]> {
+  static constexpr auto kind = FormatArgKind::String;
+};
+#define X(type, argKind)                                 \
+  template <>                                            \
+  struct FormatArgTraits<type> {                         \
+    static constexpr auto kind = FormatArgKind::argKind; \
+  };
+X(char, Char)
+X(signed char, Signed)
+X(short, Signed)
+X(int, Signed)
+X(long, Signed)
+X(long long, Signed)
+X(unsigned char, Unsigned)
+X(unsigned short, Unsigned)
+X(unsigned int, Unsigned)
+X(unsigned long, Unsigned)
+X(unsigned long long, Unsigned)
+X(char*, String)
+X(const char*, String)
+X(string_view, String)
+X(float, Float)
+X(double, Float)
+X(long double, Float)
+#undef X
+
+constexpr bool Accepts(FormatConversion conversion, FormatArgKind kind) {
+  const auto integer = kind == FormatArgKind::Signed ||
+                       kind == FormatArgKind::Unsigned ||
+                       kind == FormatArgKind::Char;
+  switch (conversion) {
+    case FormatConversion::Signed:
+    case FormatConversion::Unsigned:
+    case FormatConversion::Octal:
+    case FormatConversion::Hex:
+    case FormatConversion::HexUpper:
+    case FormatConversion::Char:
+      return integer;
+    case FormatConversion::Pointer:
+      return integer || kind == FormatArgKind::Pointer;
+    case FormatConversion::String:
+      return kind == FormatArgKind::String;
+    case FormatConversion::Fixed:
+    case FormatConversion::FixedUpper:
+    case FormatConversion::Exponent:
+    case FormatConversion::ExponentUpper:
+    case FormatConversion::General:
+    case FormatConversion::GeneralUpper:
+      return kind == FormatArgKind::Float;
+    default:
+      return false;
+  }
+}
+
+template <size_t N>
+struct ParsedFormat {
+  FormatOp ops[N > 0 ? N : 1]{};
+  size_t count = 0;
+  size_t args = 0;
+  bool valid = true;
+
+  // The conversion of the argument at `index`
+  constexpr FormatConversion argConversion(size_t index) const {
+    for (size_t i = 0; i < count; i++) {
+      if (ops[i].conversion != FormatConversion::Literal && index-- == 0)
+        return ops[i].conversion;
+    }
+    return FormatConversion::Literal;
+  }
+};  // struct ParsedFormat
+
+constexpr bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// Splits `format` into ops, storing up to `capacity` of them; returns how
+// many there are
+constexpr size_t ParseFormat(const char* format, FormatOp* ops,
+                             size_t capacity, size_t& args, bool& valid) {
+  size_t count = 0;
+  auto add = [&](const FormatOp& op) {
+    if (count < capacity)
+      ops[count] = op;
+    count++;
+  };
+  size_t i = 0;
+  while (format[i]) {
+    if (i > UINT16_MAX) {
+      valid = false;
+      return count;
+    }
+    FormatOp op;
+    op.offset = static_cast<uint16_t>(i);
+    if (format[i] != '%') {
+      while (format[i] && format[i] != '%')
+        i++;
+      op.length = static_cast<uint16_t>(i - op.offset);
+      add(op);
+      continue;
+    }
+    i++;
+    for (;; i++) {
+      if (format[i] == '-') {
+        op.flags |= FormatOp::kLeft;
+      } else if (format[i] == '+') {
+        op.flags |= FormatOp::kPlus;
+      } else if (format[i] == ' ') {
+        op.flags |= FormatOp::kSpace;
+      } else if (format[i] == '#') {
+        op.flags |= FormatOp::kHash;
+      } else if (format[i] == '0') {
+        op.flags |= FormatOp::kZero;
+      } else {
+        break;
+      }
+    }
+    int width = 0;
+    while (IsDigit(format[i]) && width <= UINT16_MAX)
+      width = width * 10 + (format[i++] - '0');
+    int precision = -1;
+    if (format[i] == '.') {
+      i++;
+      precision = 0;
+      while (IsDigit(format[i]) && precision <= INT16_MAX)
+        precision = precision * 10 + (format[i++] - '0');
+    }
+    if (width > UINT16_MAX || precision > INT16_MAX) {
+      valid = false;
+      return count;
+    }
+    op.width = static_cast<uint16_t>(width);
+    op.precision = static_cast<int16_t>(precision);
+    switch (format[i]) {
+      case 'h':
+        op.size = format[++i] == 'h' ? 1 : 2;
+        i += op.size == 1;
+        break;
+      case 'l':
+        i += format[i + 1] == 'l';
+        [[fallthrough]];
+      case 'j':
+      case 'z':
+      case 't':
+        op.size = 8;
+        i++;
+        break;
+      case 'L':  // long double, which arguments already say
+        i++;
+        break;
+    }
+    switch (format[i++]) {
+      case 'd':
+      case 'i':
+        op.conversion = FormatConversion::Signed;
+        break;
+      case 'u':
+        op.conversion = FormatConversion::Unsigned;
+        break;
+      case 'o':
+        op.conversion = FormatConversion::Octal;
+        break;
+      case 'x':
+        op.conversion = FormatConversion::Hex;
+        break;
+      case 'X':
+        op.conversion = FormatConversion::HexUpper;
+        break;
+      case 'p':
+        op.conversion = FormatConversion::Pointer;
+        break;
+      case 'c':
+        op.conversion = FormatConversion::Char;
+        break;
+      case 's':
+        op.conversion = FormatConversion::String;
+        break;
+      case 'f':
+        op.conversion = FormatConversion::Fixed;
+        break;
+      case 'F':
+        op.conversion = FormatConversion::FixedUpper;
+        break;
+      case 'e':
+        op.conversion = FormatConversion::Exponent;
+        break;
+      case 'E':
+        op.conversion = FormatConversion::ExponentUpper;
+        break;
+      case 'g':
+        op.conversion = FormatConversion::General;
+        break;
+      case 'G':
+        op.conversion = FormatConversion::GeneralUpper;
+        break;
+      case '%':
+        op.offset = static_cast<uint16_t>(i - 1);
+        op.length = 1;
+        add(op);
+        continue;
+      default:  // %n, %*, %a, or junk
+        valid = false;
+        return count;
+    }
+    args++;
+    add(op);
+  }
+  return count;
+}
+
+constexpr size_t CountFormatOps(const char* format) {
+  size_t args = 0;
+  bool valid = true;
+  return ParseFormat(format, nullptr, 0, args, valid);
+}
+
+template <size_t N>
+constexpr ParsedFormat<N> ParseFormat(const char* format) {
+  ParsedFormat<N> parsed;
+  parsed.count = ParseFormat(format, parsed.ops, N, parsed.args, parsed.valid);
+  return parsed;
+}
+
+template <typename... Args, size_t N>
+constexpr bool ArgsMatch(const ParsedFormat<N>& parsed) {
+  size_t index = 0;
+  const bool matches[] = {
+      true, Accepts(parsed.argConversion(index++),
+                    FormatArgTraits<Args>::kind)...};
+  for (auto match : matches) {
+    if (!match)
+      return false;
+  }
+  return true;
+}
+
+// By reference: a long double copied by value goes through the x87, and
+// read in place it doesn't
+template <typename T>
+FormatArg ToFormatArg(const T& arg) {
+  constexpr auto kind = FormatArgTraits<T>::kind;
+  FormatArg out;
+  if constexpr (kind == FormatArgKind::String) {
+    const string_view view{arg};
+    out.str = view.c_str();
+    out.length = view.length();
+  } else if constexpr (kind == FormatArgKind::Float) {
+    if constexpr (sizeof(T) > sizeof(double)) {
+      out.real = ExtendedToDouble(&arg);
+    } else {
+      out.real = arg;
+    }
+  } else if constexpr (kind == FormatArgKind::Pointer) {
+    out.value = reinterpret_cast<uintptr_t>(arg);
+    out.size = sizeof(arg);
+  } else {
+    out.value = static_cast<uintmax_t>(arg);
+    if constexpr (sizeof(T) < sizeof(uintmax_t))
+      out.value &= (uintmax_t{1} << (sizeof(T) * 8)) - 1;
+    out.size = sizeof(T);
+    out.isSigned = static_cast<T>(-1) < 0;
+  }
+  return out;
+}
+}  // namespace detail
+
+// The parse of the format in FMT() type `Fmt`, done once at compile time
+template <typename Fmt>
+struct CompiledFormat {
+  static constexpr auto kParsed =
+      detail::ParseFormat<detail::CountFormatOps(Fmt::get())>(Fmt::get());
+
+  template <typename... Args>
+  static void render(FormatOutput& out, const Args&... args) {
+    static_assert(kParsed.valid, "Malformed or unsupported format");
+    static_assert(kParsed.args == sizeof...(Args),
+                  "Wrong number of arguments for the format");
+    static_assert(detail::ArgsMatch<Args...>(kParsed),
+                  "Argument doesn't match its conversion");
+    const FormatArg values[] = {detail::ToFormatArg(args)..., FormatArg{}};
+    RenderFormat(Fmt::get(), kParsed.ops, kParsed.count, values, out);
+  }
+};  // struct CompiledFormat
+
+// Formats into `buffer` like snprintf: keeps what fits in `size` chars,
+// always terminated, and returns the length of the whole output
+template <typename Fmt, typename... Args>
+size_t FormatTo(char* buffer, size_t size, Fmt, const Args&... args) {
+  BufferFormatOutput out{buffer, size};
+  CompiledFormat<Fmt>::render(out, args...);
+  return out.finish();
+}
+template <typename Fmt, typename... Args>
+ostream& FormatTo(ostream& stream, Fmt, const Args&... args) {
+  StreamFormatOutput out{stream};
+  CompiledFormat<Fmt>::render(out, args...);
+  return stream;
+}
+}  // namespace rtk
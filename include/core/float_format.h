@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace rtk {
+// A double in decimal: 0.digits * 10^point, the digits without a
+// terminator. Finite values only.
+struct DecimalFloat {
+  char digits[20];
+  int length;
+  int point;
+  bool negative;
+};  // struct DecimalFloat
+
+// The shortest digits that read back as `value`, found with integer
+// arithmetic only (Grisu2). 0 is the single digit '0' with a point of 1.
+DecimalFloat ShortestDecimal(double value);
+
+// Cuts `decimal`, the shortest digits of `value`, to its first `keep`
+// digits, which may be none. A 5 after them rounds by where `value` itself
+// lies, so ties are only those of the binary value. Trailing zeros go, and
+// 0 comes out as the digit '0' with a point of 1.
+void RoundDecimal(DecimalFloat& decimal, double value, int keep);
+
+// The double nearest the x87 80-bit value at `extended`, rounding to even,
+// without loading it into the x87
+double ExtendedToDouble(const void* extended);
+}  // namespace rtk
@@ -3,27 +3,90 @@
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdint.h>
+#include "core/stdlib/cstring.h"
 
 namespace rtk {
+namespace detail {
+// "00" through "99", for decimal conversion two digits at a time
+inline constexpr char kDigitPairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+inline constexpr uint64_t kPowersOf10[] = {1ULL,
+                                           10ULL,
+                                           100ULL,
+                                           1000ULL,
+                                           10000ULL,
+                                           100000ULL,
+                                           1000000ULL,
+                                           10000000ULL,
+                                           100000000ULL,
+                                           1000000000ULL,
+                                           10000000000ULL,
+                                           100000000000ULL,
+                                           1000000000000ULL,
+                                           10000000000000ULL,
+                                           100000000000000ULL,
+                                           1000000000000000ULL,
+                                           10000000000000000ULL,
+                                           100000000000000000ULL,
+                                           1000000000000000000ULL,
+                                           10000000000000000000ULL};
+inline constexpr char kHexDigits[] = "0123456789abcdef";
+inline constexpr char kHexDigitsUpper[] = "0123456789ABCDEF";
+}  // namespace detail
+
+// Digits in `value` written in `base` (8, 10 or 16); 1 for 0. Decimal
+// estimates log10 from the bit length and corrects by one comparison.
+template <int base = 10>
+constexpr int countdigits(uintmax_t value) {
+  const int bits = 64 - __builtin_clzll(value | 1);
+  if constexpr (base == 16) {
+    return (bits + 3) / 4;
+  } else if constexpr (base == 8) {
+    return (bits + 2) / 3;
+  } else {
+    const int guess = (bits * 1233) >> 12;  // 1233 / 4096 ~ log10(2)
+    return guess + ((value | 1) >= detail::kPowersOf10[guess]);
+  }
+}
+
+// Writes `value` in `base` at `out`, most significant digit first and
+// without a terminator; returns the number of digits, at most 22
 template <int base = 10, bool upper = false>
-static inline void outdigits(uintmax_t value, int& digits, char*& buffer) {
-  // Add digits in reverse
-  while (value > 0) {
-    const auto rem = value % base;
-    auto& digit = *(--buffer);
-    digits++;
-    if constexpr (base == 16) {
-      constexpr auto alphastart = upper ? 'A' : 'a';
-      digit = rem < 10 ? '0' + rem : alphastart + (rem - 10);
+inline int todigits(uintmax_t value, char* out) {
+  const auto digits = countdigits<base>(value);
+  auto end = out + digits;
+  if constexpr (base == 16) {
+    constexpr auto table =
+        upper ? detail::kHexDigitsUpper : detail::kHexDigits;
+    do {
+      *(--end) = table[value & 15];
+      value >>= 4;
+    } while (end != out);
+  } else if constexpr (base == 8) {
+    do {
+      *(--end) = static_cast<char>('0' + (value & 7));
+      value >>= 3;
+    } while (end != out);
+  } else {
+    while (value >= 100) {
+      const auto pair = (value % 100) * 2;
+      value /= 100;
+      end -= 2;
+      end[0] = detail::kDigitPairs[pair];
+      end[1] = detail::kDigitPairs[pair + 1];
+    }
+    if (value >= 10) {
+      out[0] = detail::kDigitPairs[value * 2];
+      out[1] = detail::kDigitPairs[value * 2 + 1];
     } else {
-      digit = '0' + rem;
+      out[0] = static_cast<char>('0' + value);
     }
-    value /= base;
-  }
-  if (digits == 0) {
-    *(--buffer) = '0';
-    digits++;
   }
+  return digits;
 }
 
 class Formatter {
@@ -35,8 +98,12 @@ class Formatter {
   // int nparsef(const char* format, size_t count, ...) const;
 
  protected:
-  // virtual size_t outputChars(const char* chars, size_t length) const = 0;
-  virtual size_t outputChars(const char* chars) const = 0;
+  // Gets the output a piece at a time: each run of literal chars between
+  // conversions and each converted argument, not null-terminated
+  virtual size_t outputChars(const char* chars, size_t length) const = 0;
+  size_t outputChars(const char* chars) const {
+    return outputChars(chars, strlen(chars));
+  }
   //mutable size_t charsPrinted_;
 
  private:
@@ -52,6 +119,8 @@ class Formatter {
   void parsePrecision() const;
   void parseLength() const;
   void outputNumber(uintmax_t val, bool isSigned, bool upper, int base) const;
+  void outputFill(char fill, int count) const;
+  void outputFloat(double value, char conversion) const;
   enum class FormatFlags {
     None = 0,
     LeftJustify = 1,
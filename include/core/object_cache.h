@@ -0,0 +1,172 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/stdlib/freestanding/new.h"
+
+namespace rtk {
+// Cache of constructed objects of one type, kept in slabs (kmem_cache
+// style). Objects are constructed when their slab is created and destroyed
+// only when reap() or the cache's destructor frees the slab, so allocate()
+// and free() never run T's constructor or destructor. Objects must come back
+// in their constructed state, and all of them must be back before the cache
+// is destroyed.
+// Each object starts on its own cache line, followed by a pointer to its
+// slab so free() is O(1). Not thread-safe: callers serialize access.
+template <typename T>
+class ObjectCache final {
+ public:
+  static constexpr size_t kCacheLine = 64;
+  static_assert(alignof(T) <= kCacheLine, "T is over-aligned");
+
+  ObjectCache() = default;
+  ObjectCache(const ObjectCache& other) = delete;
+  ObjectCache& operator=(const ObjectCache& other) = delete;
+  ~ObjectCache() {
+    destroyList(partial_);
+    destroyList(full_);
+  }
+
+  // A constructed object, or nullptr when out of memory
+  T* allocate() {
+    if (partial_ == nullptr && !grow())
+      return nullptr;
+
+    auto slab = partial_;
+    auto index = slab->freeStack[--slab->freeCount];
+    if (slab->freeCount == 0) {
+      unlink(partial_, slab);
+      link(full_, slab);
+    }
+    return object(slab, index);
+  }
+
+  // Takes back an object from allocate(), still constructed
+  void free(T* obj) {
+    if (obj == nullptr)
+      return;
+
+    auto slab = owner(obj);
+    if (slab->freeCount == 0) {
+      unlink(full_, slab);
+      link(partial_, slab);
+    }
+    const auto offset = reinterpret_cast<uintptr_t>(obj) -
+                        reinterpret_cast<uintptr_t>(slab->objects);
+    slab->freeStack[slab->freeCount++] =
+        static_cast<uint16_t>(offset / kStride);
+  }
+
+  // Destroys the objects of slabs with none in use and frees the slabs.
+  // Returns how many were freed.
+  size_t reap() {
+    size_t reaped = 0;
+    auto slab = partial_;
+    while (slab != nullptr) {
+      auto next = slab->next;
+      if (slab->freeCount == kObjectsPerSlab) {
+        unlink(partial_, slab);
+        destroy(slab);
+        reaped++;
+      }
+      slab = next;
+    }
+    return reaped;
+  }
+
+  // Objects handed out or ready to be
+  size_t capacity() const { return slabCount_ * kObjectsPerSlab; }
+
+ private:
+  static constexpr size_t kOwnerSize = sizeof(void*);
+  // Object, then the slab pointer, rounded up to whole cache lines
+  static constexpr size_t kStride =
+      (sizeof(T) + kOwnerSize + kCacheLine - 1) / kCacheLine * kCacheLine;
+  // Around 4 KiB of objects per slab, but never fewer than 8
+  static constexpr size_t kObjectsPerSlab =
+      kStride * 8 <= 4096 ? 4096 / kStride : 8;
+
+  struct Slab {
+    Slab* prev;
+    Slab* next;
+    unsigned char* memory;   // as allocated, for delete[]
+    unsigned char* objects;  // first object, cache line aligned
+    size_t freeCount;
+    uint16_t freeStack[kObjectsPerSlab];  // indices of free objects
+  };
+
+  Slab* partial_ = nullptr;  // at least one free object
+  Slab* full_ = nullptr;
+  size_t slabCount_ = 0;
+
+  static T* object(Slab* slab, size_t index) {
+    return reinterpret_cast<T*>(slab->objects + index * kStride);
+  }
+  static Slab*& owner(T* obj) {
+    return *reinterpret_cast<Slab**>(reinterpret_cast<unsigned char*>(obj) +
+                                     kStride - kOwnerSize);
+  }
+  static void link(Slab*& head, Slab* slab) {
+    slab->prev = nullptr;
+    slab->next = head;
+    if (head != nullptr) {
+      head->prev = slab;
+    }
+    head = slab;
+  }
+  static void unlink(Slab*& head, Slab* slab) {
+    if (slab->prev != nullptr) {
+      slab->prev->next = slab->next;
+    } else {
+      head = slab->next;
+    }
+    if (slab->next != nullptr) {
+      slab->next->prev = slab->prev;
+    }
+  }
+
+  bool grow() {
+    // Header, then padding up to the first cache line boundary
+    constexpr auto bytes =
+        sizeof(Slab) + kCacheLine + kObjectsPerSlab * kStride;
+    auto memory = new unsigned char[bytes];
+    if (memory == nullptr)
+      return false;  // out of mem?
+
+    auto slab = new (memory) Slab{};
+    slab->memory = memory;
+    const auto first = reinterpret_cast<uintptr_t>(memory + sizeof(Slab));
+    slab->objects = reinterpret_cast<unsigned char*>(
+        (first + kCacheLine - 1) & ~(uintptr_t)(kCacheLine - 1));
+
+    // Lowest addresses come out first
+    for (size_t i = 0; i < kObjectsPerSlab; i++) {
+      auto obj = new (object(slab, i)) T{};
+      owner(obj) = slab;
+      slab->freeStack[kObjectsPerSlab - 1 - i] = static_cast<uint16_t>(i);
+    }
+    slab->freeCount = kObjectsPerSlab;
+
+    link(partial_, slab);
+    slabCount_++;
+    return true;
+  }
+
+  void destroy(Slab* slab) {
+    for (size_t i = 0; i < kObjectsPerSlab; i++) {
+      object(slab, i)->~T();
+    }
+    slabCount_--;
+    delete[] slab->memory;
+  }
+
+  void destroyList(Slab*& head) {
+    while (head != nullptr) {
+      auto slab = head;
+      head = slab->next;
+      destroy(slab);
+    }
+  }
+};  // class ObjectCache
+}  // namespace rtk
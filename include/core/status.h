@@ -21,7 +21,8 @@
   X(0x00000006, OutOfRange, "Argument or value out of range")   \
   X(0x00000007, Uninitialized, "Using an uninitialized object") \
   X(0x00000008, InitializationError, "Failed to initialize")    \
-  X(0x00000009, ValueNotPresent, "The requested value is not present")
+  X(0x00000009, ValueNotPresent, "The requested value is not present") \
+  X(0x0000000A, AlreadyExists, "The target already exists")
 #define STATUS_UNDEFINED "Undefined status code"
 
 namespace rtk {
@@ -88,7 +89,8 @@ class StatusOr {
   StatusOr(T t) : hasT_{true}, item_{t} {}
   StatusOr() : StatusOr(rtk::StatusCode::Unknown) {}
   StatusOr(const StatusOr& other) : StatusOr() { *this = other; }
-  StatusOr(StatusOr&& other) noexcept : StatusOr() { swap(*this, other); }
+  // Not via swap(), which move-constructs its temporary
+  StatusOr(StatusOr&& other) noexcept : StatusOr() { *this = move(other); }
   StatusOr& operator=(const StatusOr& other) {
     if (this == &other)
       return *this;
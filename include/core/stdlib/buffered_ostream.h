@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include "core/stdlib/freestanding/string.h"  // rtk::memcpy
+#include "core/stdlib/ostream.h"
+
+namespace rtk {
+// An ostream that gathers writes in a fixed buffer of `Size` chars, in the
+// manner of a streambuf, and hands them to sink() only when the buffer fills
+// up or on flush(). Writes at least as big as the buffer skip it.
+//
+// The destructor can't call sink(), so derived classes flush() in theirs.
+template <size_t Size>
+class buffered_ostream : public ostream {
+  static_assert(Size > 0, "buffered_ostream needs a buffer");
+
+ public:
+  using ostream::write;
+  ostream& write(const char* str, size_t length) override {
+    if (length > Size - used_) {
+      drain();
+      if (length >= Size) {
+        sink(str, length);
+        return *this;
+      }
+    }
+    memcpy(buffer_ + used_, str, length);
+    used_ += length;
+    return *this;
+  }
+  ostream& flush() override {
+    drain();
+    return *this;
+  }
+  // Chars written but not yet sunk
+  size_t pending() const { return used_; }
+
+ protected:
+  // Takes `length` chars of output, which aren't null-terminated
+  virtual void sink(const char* str, size_t length) = 0;
+
+ private:
+  void drain() {
+    if (used_ > 0) {
+      sink(buffer_, used_);
+      used_ = 0;
+    }
+  }
+  char buffer_[Size];
+  size_t used_ = 0;
+};  // class buffered_ostream
+}  // namespace rtk
@@ -1,20 +1,257 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
+#include "core/stdlib/freestanding/string.h"  // rtk::memcpy, rtk::memset
 
 namespace rtk {
-static constexpr size_t strlen(const char* str) {
-  if (str == nullptr)
+// Block-at-a-time scans behind the functions below. Aligned loads never
+// cross into the next page, so scans may read past the end of a string,
+// which AddressSanitizer would otherwise report.
+#define NO_SANITIZE_ADDRESS __attribute__((no_sanitize("address")))
+namespace detail {
+constexpr size_t kMinPageSize = 4096;
+
+// 8 bytes in a general register, using the has-zero-byte bit trick. Masks
+// have bit 7 of each selected byte set.
+struct word_ops {
+  typedef uint64_t block __attribute__((may_alias));
+  typedef uint64_t unaligned_block __attribute__((aligned(1), may_alias));
+  static constexpr size_t kSize = 8;
+  static constexpr uint64_t kLow7 = 0x7F7F7F7F7F7F7F7FULL;
+
+  NO_SANITIZE_ADDRESS static block load(const void* p) {
+    return *static_cast<const block*>(p);
+  }
+  NO_SANITIZE_ADDRESS static block load_unaligned(const void* p) {
+    return *static_cast<const unaligned_block*>(p);
+  }
+  static block broadcast(unsigned char c) {
+    return c * 0x0101010101010101ULL;
+  }
+  // Exact per byte, so any bit of the mask may be used, not just the first
+  static uint64_t nonzero(block v) {
+    return (((v & kLow7) + kLow7) | v) & ~kLow7;
+  }
+  static uint64_t zeros(block v) { return ~nonzero(v) & ~kLow7; }
+  static uint64_t equal(block a, block b) { return zeros(a ^ b); }
+  static uint64_t differ(block a, block b) { return nonzero(a ^ b); }
+  // Index of the first selected byte in a non-zero mask
+  static size_t first(uint64_t mask) { return __builtin_ctzll(mask) / 8; }
+  // Drops the selections of the first `count` bytes
+  static uint64_t skip(uint64_t mask, size_t count) {
+    return mask >> (count * 8) << (count * 8);
+  }
+};  // struct word_ops
+
+#ifdef __SSE2__
+// 16 bytes in an SSE2 register. Masks have one bit per byte.
+struct sse2_ops {
+  typedef char block __attribute__((vector_size(16), may_alias));
+  typedef char unaligned_block
+      __attribute__((vector_size(16), aligned(1), may_alias));
+  static constexpr size_t kSize = 16;
+
+  NO_SANITIZE_ADDRESS static block load(const void* p) {
+    return *static_cast<const block*>(p);
+  }
+  NO_SANITIZE_ADDRESS static block load_unaligned(const void* p) {
+    return *static_cast<const unaligned_block*>(p);
+  }
+  static block broadcast(unsigned char c) {
+    return block{} + static_cast<char>(c);
+  }
+  static uint64_t zeros(block v) { return equal(v, block{}); }
+  static uint64_t equal(block a, block b) {
+    return static_cast<unsigned>(__builtin_ia32_pmovmskb128((block)(a == b)));
+  }
+  static uint64_t differ(block a, block b) { return equal(a, b) ^ 0xFFFF; }
+  static size_t first(uint64_t mask) { return __builtin_ctzll(mask); }
+  static uint64_t skip(uint64_t mask, size_t count) {
+    return mask >> count << count;
+  }
+};  // struct sse2_ops
+using fast_ops = sse2_ops;
+#else
+using fast_ops = word_ops;
+#endif
+
+// Scans aligned blocks from the one holding `p` until `found` selects a
+// byte at or after `p`; returns that byte's offset from `p`, or at least
+// `limit` when there's none before it
+template <typename Ops, typename Found>
+size_t scan(const char* p, size_t limit, Found found) {
+  const auto offset = reinterpret_cast<uintptr_t>(p) & (Ops::kSize - 1);
+  auto block = p - offset;
+  auto mask = Ops::skip(found(Ops::load(block)), offset);
+  size_t scanned = Ops::kSize - offset;
+  while (mask == 0) {
+    if (scanned >= limit)
+      return limit;
+    block += Ops::kSize;
+    mask = found(Ops::load(block));
+    scanned += Ops::kSize;
+  }
+  return static_cast<size_t>(block - p) + Ops::first(mask);
+}
+
+template <typename Ops>
+size_t block_strlen(const char* str) {
+  return scan<Ops>(str, SIZE_MAX, [](auto v) { return Ops::zeros(v); });
+}
+template <typename Ops>
+size_t block_strnlen(const char* str, size_t n) {
+  if (n == 0)
     return 0;
-  auto len = 0;
-  while (*(str++))
+  const auto len = scan<Ops>(str, n, [](auto v) { return Ops::zeros(v); });
+  return len < n ? len : n;
+}
+template <typename Ops>
+const void* block_memchr(const void* ptr, unsigned char c, size_t n) {
+  if (n == 0)
+    return nullptr;
+  const auto target = Ops::broadcast(c);
+  const auto p = static_cast<const char*>(ptr);
+  const auto at =
+      scan<Ops>(p, n, [target](auto v) { return Ops::equal(v, target); });
+  return at < n ? p + at : nullptr;
+}
+template <typename Ops>
+int block_memcmp(const void* a, const void* b, size_t n) {
+  auto pa = static_cast<const unsigned char*>(a);
+  auto pb = static_cast<const unsigned char*>(b);
+  size_t i = 0;
+  for (; i + Ops::kSize <= n; i += Ops::kSize) {
+    const auto mask =
+        Ops::differ(Ops::load_unaligned(pa + i), Ops::load_unaligned(pb + i));
+    if (mask != 0) {
+      i += Ops::first(mask);
+      return pa[i] - pb[i];
+    }
+  }
+  // A short tail still goes a word at a time
+  if constexpr (Ops::kSize > word_ops::kSize) {
+    if (n - i >= word_ops::kSize)
+      return block_memcmp<word_ops>(pa + i, pb + i, n - i);
+  }
+  for (; i < n; i++) {
+    if (pa[i] != pb[i])
+      return pa[i] - pb[i];
+  }
+  return 0;
+}
+// Compares a block at a time while neither string is near the end of a
+// page, and a byte at a time across page boundaries
+template <typename Ops>
+int block_strncmp(const char* a, const char* b, size_t n) {
+  auto pa = reinterpret_cast<const unsigned char*>(a);
+  auto pb = reinterpret_cast<const unsigned char*>(b);
+  constexpr auto kLastSafe = kMinPageSize - Ops::kSize;
+  size_t i = 0;
+  while (i < n) {
+    if ((reinterpret_cast<uintptr_t>(pa + i) & (kMinPageSize - 1)) <=
+            kLastSafe &&
+        (reinterpret_cast<uintptr_t>(pb + i) & (kMinPageSize - 1)) <=
+            kLastSafe) {
+      const auto va = Ops::load_unaligned(pa + i);
+      const auto mask =
+          Ops::differ(va, Ops::load_unaligned(pb + i)) | Ops::zeros(va);
+      if (mask == 0) {
+        i += Ops::kSize;
+        continue;
+      }
+      i += Ops::first(mask);
+      if (i >= n)
+        return 0;
+      return pa[i] - pb[i];
+    }
+    if (pa[i] != pb[i] || pa[i] == '\0')
+      return pa[i] - pb[i];
+    i++;
+  }
+  return 0;
+}
+
+// The byte-at-a-time versions, for constant evaluation
+constexpr size_t byte_strnlen(const char* str, size_t n) {
+  size_t len = 0;
+  while (len < n && str[len])
     len++;
   return len;
+}
+constexpr int byte_strncmp(const char* a, const char* b, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    const auto ca = static_cast<unsigned char>(a[i]);
+    const auto cb = static_cast<unsigned char>(b[i]);
+    if (ca != cb || ca == '\0')
+      return ca - cb;
+  }
+  return 0;
+}
+}  // namespace detail
+#undef NO_SANITIZE_ADDRESS
+
+static constexpr size_t strlen(const char* str) {
+  if (str == nullptr)
+    return 0;
+  if (!__builtin_is_constant_evaluated())
+    return detail::block_strlen<detail::fast_ops>(str);
+  return detail::byte_strnlen(str, SIZE_MAX);
 }  // strlen
+// At most `n`
+static constexpr size_t strnlen(const char* str, size_t n) {
+  if (str == nullptr)
+    return 0;
+  if (!__builtin_is_constant_evaluated())
+    return detail::block_strnlen<detail::fast_ops>(str, n);
+  return detail::byte_strnlen(str, n);
+}  // strnlen
+static constexpr const char* memchr(const char* ptr, char c, size_t n) {
+  if (!__builtin_is_constant_evaluated())
+    return static_cast<const char*>(
+        detail::block_memchr<detail::fast_ops>(ptr, c, n));
+  for (size_t i = 0; i < n; i++) {
+    if (ptr[i] == c)
+      return ptr + i;
+  }
+  return nullptr;
+}  // memchr
+static inline const void* memchr(const void* ptr, int c, size_t n) {
+  return detail::block_memchr<detail::fast_ops>(ptr, c, n);
+}  // memchr
+static constexpr int memcmp(const char* a, const char* b, size_t n) {
+  if (!__builtin_is_constant_evaluated())
+    return detail::block_memcmp<detail::fast_ops>(a, b, n);
+  for (size_t i = 0; i < n; i++) {
+    const auto ca = static_cast<unsigned char>(a[i]);
+    const auto cb = static_cast<unsigned char>(b[i]);
+    if (ca != cb)
+      return ca - cb;
+  }
+  return 0;
+}  // memcmp
+static inline int memcmp(const void* a, const void* b, size_t n) {
+  return detail::block_memcmp<detail::fast_ops>(a, b, n);
+}  // memcmp
+// nullptr compares like ""
+static constexpr int strncmp(const char* a, const char* b, size_t n) {
+  a = a != nullptr ? a : "";
+  b = b != nullptr ? b : "";
+  if (!__builtin_is_constant_evaluated())
+    return detail::block_strncmp<detail::fast_ops>(a, b, n);
+  return detail::byte_strncmp(a, b, n);
+}  // strncmp
+static constexpr int strcmp(const char* a, const char* b) {
+  return strncmp(a, b, SIZE_MAX);
+}  // strcmp
 static constexpr char* strcpy(char* dest, const char* src) {
   auto start = dest;
   if (dest != nullptr && dest != src) {
     if (src != nullptr) {
+      if (!__builtin_is_constant_evaluated()) {
+        rtk::memcpy(dest, src, strlen(src) + 1);
+        return start;
+      }
       while (*src)
         *(dest++) = *(src++);
       *dest = '\0';
@@ -28,6 +265,12 @@ static constexpr char* strncpy(char* dest, const char* src, size_t n) {
   size_t i = 0;
   if (dest != nullptr && dest != src) {
     if (src != nullptr) {
+      if (!__builtin_is_constant_evaluated()) {
+        const auto len = strnlen(src, n);
+        rtk::memcpy(dest, src, len);
+        rtk::memset(dest + len, 0, n - len);
+        return start;
+      }
       while (*src && (i++ < n))
         *(dest++) = *(src++);
       // Fill all the rest with zeroes
@@ -37,4 +280,4 @@ static constexpr char* strncpy(char* dest, const char* src, size_t n) {
   }
   return start;
 }  // strncpy
-}  // namespace rtk
\ No newline at end of file
+}  // namespace rtk
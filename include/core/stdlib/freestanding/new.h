@@ -5,5 +5,25 @@
 // Implemented in kernel/lib/cpp/runtime_support.cpp
 void* operator new(size_t, void* ptr) noexcept;
 void operator delete(void*, void*) noexcept;
-void operator delete(void*) noexcept;
-void operator delete(void*, size_t) noexcept;
\ No newline at end of file
+
+#if !__STDC_HOSTED__
+namespace std {
+struct nothrow_t {
+  explicit nothrow_t() = default;
+};
+extern const nothrow_t nothrow;
+}  // namespace std
+#else
+#include <new>
+#endif
+
+// Implemented in kernel/lib/cpp/new.cpp, on the kernel heap. Plain new
+// never returns nullptr; the nothrow forms do when the heap runs out.
+void* operator new(size_t size);
+void* operator new[](size_t size);
+void* operator new(size_t size, const std::nothrow_t&) noexcept;
+void* operator new[](size_t size, const std::nothrow_t&) noexcept;
+void operator delete(void* ptr) noexcept;
+void operator delete(void* ptr, size_t) noexcept;
+void operator delete[](void* ptr) noexcept;
+void operator delete[](void* ptr, size_t) noexcept;
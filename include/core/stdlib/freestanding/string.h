@@ -10,6 +10,7 @@ extern "C" {
 // Required since the c standard allows struct copies to use memcpy internally
 void* memcpy(void* dest, const void* src, size_t n);
 void memset(void* dest, unsigned char val, size_t n);
+void* memmove(void* dest, const void* src, size_t n);
 #ifdef __cplusplus
 }  // extern "C"
 }  // namespace rtk
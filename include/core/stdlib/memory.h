@@ -1,6 +1,8 @@
 #pragma once
 
 #include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 // #include <initializer_list>
 #include "core/stdlib/stdlib.h"       // rtk::panic
 #include "core/stdlib/type_traits.h"  // rtk::enable_if
@@ -20,6 +22,8 @@ using virtual_unique_ptr = unique_ptr<T, virtual_deleter<T>>;
 template <typename T>
 enable_if_t<is_inherited_from_v<VirtualDelete<T>, T>, virtual_unique_ptr<T>>
 make_unique(T* obj);
+template <typename T>
+class ObjectCache;  // core/object_cache.h
 
 template <class T>
 class heap_deleter final {
@@ -70,7 +74,10 @@ template <class T>
 class DynamicPlacement : public VirtualDelete<T> {
  public:
   void deleter() const override {
-    if (isHeapAllocated_) {
+    if (recycle_ != nullptr) {
+      // back to its ObjectCache, still constructed
+      recycle_(cache_, const_cast<T*>(static_cast<const T*>(this)));
+    } else if (isHeapAllocated_) {
       // normal or array delete
       // (base VirtualDelete uses heap)
       VirtualDelete<T>::deleter();
@@ -97,39 +104,79 @@ class DynamicPlacement : public VirtualDelete<T> {
       return virtual_unique_ptr<T>{ptr};
     }
 
+    // Draws an already constructed object from `cache` instead of the heap.
+    // Deleting it hands it back to the cache without destroying it.
+    static virtual_unique_ptr<T> create_from(ObjectCache<Derived>& cache) {
+      auto ptr = cache.allocate();
+      if (ptr == nullptr)
+        return virtual_unique_ptr<T>{nullptr};  // out of mem?
+      ptr->cache_ = &cache;
+      ptr->recycle_ = [](void* from, T* obj) {
+        auto owner = static_cast<ObjectCache<Derived>*>(from);
+        owner->free(static_cast<Derived*>(obj));
+      };
+      return virtual_unique_ptr<T>{ptr};
+    }
+
   };  // class DynamicPlacement<T>::Factory<Derived>
 
  private:
   bool isHeapAllocated_ = true;
+  // Set for objects drawn from an ObjectCache
+  void* cache_ = nullptr;
+  void (*recycle_)(void* cache, T* obj) = nullptr;
 };
 
-// // Don't use for arrays
-// // Array specializations of templates (T[])
-// // will use the array version
-// template <typename T, typename... Args>
-// class heap_allocator final {
-//  public:
-//   // Null check responsibility on caller
-//   // Don't use for arrays
-//   // `new` should gracefully return null upon failure
-//   T* alloc(Args&&...) { return new T{Args...}; }
-// };  // class heap_allocator<T, ...Args>
+// Allocators hand containers uninitialized room for `count` Ts:
+//   T* allocate(size_t count) const;  // nullptr when out of memory
+//   void deallocate(T* ptr, size_t count) const;  // same count; null is ok
+// Stateless ones cost a container no space (see policy_holder).
 
-// template <typename T>
-// class heap_array_allocator final {
-//  public:
-//   // Null check responsibility on caller
-//   // `new` should gracefully return null upon failure,
-//   // and destruct any objects already allocated
-//   // Destructed objects should not leave dangling
-//   // pointers when moved.
-//   T* alloc(size_t count) {
-//     return new T[count]{};  // value initialized
-//   }
-// };  // class heap_array_allocator<T>
+// The global heap, up to 16-byte alignment. The default everywhere.
+template <typename T>
+class heap_allocator final {
+ public:
+  using value_type = T;
+
+  T* allocate(size_t count) const {
+    if (count > SIZE_MAX / sizeof(T))
+      return nullptr;
+    return reinterpret_cast<T*>(new unsigned char[count * sizeof(T)]);
+  }
+  void deallocate(T* ptr, size_t) const {
+    delete[] reinterpret_cast<unsigned char*>(ptr);
+  }
+};  // class heap_allocator<T>
+
+// Keeps a deleter or allocator, taking no room when it has no state: a
+// stateless one is just made again on each use
+template <class Policy, bool = is_empty_v<Policy>>
+class policy_holder {
+ public:
+  policy_holder() = default;
+  policy_holder(const Policy& policy) : policy_{policy} {}
+
+  Policy& policy() { return policy_; }
+  const Policy& policy() const { return policy_; }
+
+ private:
+  Policy policy_{};
+};  // class policy_holder
+
+template <class Policy>
+class policy_holder<Policy, true> {
+ public:
+  policy_holder() = default;
+  policy_holder(const Policy&) {}
+
+  Policy policy() const { return Policy{}; }
+};  // class policy_holder<Policy, true>
 
 template <class T, class Deleter>
-class unique_ptr_base {
+class unique_ptr_base : protected policy_holder<Deleter> {
+ protected:
+  using Holder = policy_holder<Deleter>;
+
  public:
   using BaseType = T;
   // Can't copy-- it's what makes it unique
@@ -142,6 +189,7 @@ class unique_ptr_base {
   unique_ptr_base& operator=(unique_ptr_base&& other) noexcept {
     if (this != &other) {
       // swap(*this, other); // don't!!!
+      static_cast<Holder&>(*this) = static_cast<Holder&>(other);
       ptr_ = other.ptr_;
       other.ptr_ = nullptr;
     }
@@ -150,7 +198,7 @@ class unique_ptr_base {
 
   void reset(T* new_ptr = nullptr) {
     // Null delete should be safe; no-op
-    Deleter{}(ptr_);
+    Holder::policy()(ptr_);
     ptr_ = new_ptr;
   }
 
@@ -179,9 +227,13 @@ class unique_ptr_base {
   bool operator!() const { return ptr_ == nullptr; }
   operator bool() const { return ptr_ != nullptr; }
 
+  // A copy for stateless deleters
+  decltype(auto) get_deleter() { return Holder::policy(); }
+  decltype(auto) get_deleter() const { return Holder::policy(); }
+
   ~unique_ptr_base() {
     // Assumed safe, no-op on null
-    Deleter{}(ptr_);
+    Holder::policy()(ptr_);
   }
 
  protected:
@@ -190,6 +242,9 @@ class unique_ptr_base {
   // Caller must avoid dangling pointers after relinquishing ownership to unique_ptr
   // null pointers are valid for safety
   unique_ptr_base(T* ptr) : ptr_{ptr} {}
+  // For deleters with state, e.g. the resource the object came from
+  unique_ptr_base(T* ptr, const Deleter& deleter)
+      : Holder{deleter}, ptr_{ptr} {}
   // don't do this-- what if you accidentally pass an lvalue instead of pointer?
   // then the object will be copy constructed using this overload instead of (T* ptr)
   // template <typename... Args>
@@ -204,11 +259,14 @@ class unique_ptr : public unique_ptr_base<T, Deleter> {
   // Caller must avoid dangling pointers after relinquishing ownership to unique_ptr
   // null pointers are valid for safety
   unique_ptr(T* ptr) : Base{ptr} {}
+  unique_ptr(T* ptr, const Deleter& deleter) : Base{ptr, deleter} {}
   // Defined in derived class for consistency
   friend void swap(unique_ptr& a, unique_ptr& b) noexcept {
     using rtk::swap;
 
     swap(a.ptr_, b.ptr_);
+    swap(static_cast<typename Base::Holder&>(a),
+         static_cast<typename Base::Holder&>(b));
   }
 
   // don't do this-- what if you accidentally pass an lvalue instead of pointer?
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/stdlib/freestanding/new.h"  // placement new
+#include "core/stdlib/memory.h"
+#include "core/stdlib/utility.h"
+
+namespace rtk {
+// Where a container or arena gets its memory from
+class memory_resource {
+ public:
+  // `bytes` aligned to `alignment`, a power of two; nullptr when out of
+  // memory or the alignment isn't supported
+  virtual void* allocate(size_t bytes, size_t alignment) = 0;
+  // Gives back memory from allocate() with the same size and alignment
+  virtual void deallocate(void* ptr, size_t bytes, size_t alignment) = 0;
+
+ protected:
+  // Never deleted through the interface, which keeps globals of trivially
+  // destructible resources free of exit-time destructors
+  constexpr memory_resource() = default;
+  ~memory_resource() = default;
+};  // class memory_resource
+
+// The global heap: new[] and delete[], up to 16-byte alignment
+class heap_memory_resource final : public memory_resource {
+ public:
+  static constexpr size_t kMaxAlignment = 16;
+
+  constexpr heap_memory_resource() = default;
+  void* allocate(size_t bytes, size_t alignment) override {
+    if (alignment > kMaxAlignment)
+      return nullptr;
+    return new unsigned char[bytes];
+  }
+  void deallocate(void* ptr, size_t, size_t) override {
+    delete[] static_cast<unsigned char*>(ptr);
+  }
+};  // class heap_memory_resource
+
+// Constant-initialized, so usable before static constructors run
+inline heap_memory_resource heap_resource_instance;
+inline memory_resource& heap_resource() {
+  return heap_resource_instance;
+}
+
+// Allocator over a memory_resource, e.g. an Arena, for vector and string
+template <typename T>
+class resource_allocator final {
+ public:
+  using value_type = T;
+
+  resource_allocator(memory_resource& resource = heap_resource())
+      : resource_{&resource} {}
+
+  T* allocate(size_t count) const {
+    if (count > SIZE_MAX / sizeof(T))
+      return nullptr;
+    return static_cast<T*>(resource_->allocate(count * sizeof(T), alignof(T)));
+  }
+  void deallocate(T* ptr, size_t count) const {
+    if (ptr != nullptr) {
+      resource_->deallocate(ptr, count * sizeof(T), alignof(T));
+    }
+  }
+  memory_resource& resource() const { return *resource_; }
+
+ private:
+  memory_resource* resource_;
+};  // class resource_allocator<T>
+
+// Destroys an object and gives its memory back to the resource it came
+// from. The object must be exactly a T.
+template <typename T>
+class resource_deleter final {
+ public:
+  resource_deleter(memory_resource& resource = heap_resource())
+      : resource_{&resource} {}
+
+  void operator()(T* obj) const {
+    if (obj == nullptr)
+      return;
+    obj->~T();
+    resource_->deallocate(obj, sizeof(T), alignof(T));
+  }
+
+ private:
+  memory_resource* resource_;
+};  // class resource_deleter<T>
+
+template <typename T>
+using resource_unique_ptr = unique_ptr<T, resource_deleter<T>>;
+
+// make_unique() from `resource` instead of the heap. Null when out of mem.
+template <typename T, typename... Args>
+resource_unique_ptr<T> allocate_unique(memory_resource& resource,
+                                       Args&&... args) {
+  auto memory = resource.allocate(sizeof(T), alignof(T));
+  if (memory == nullptr)
+    return resource_unique_ptr<T>{nullptr, resource_deleter<T>{resource}};
+  return resource_unique_ptr<T>{new (memory) T(rtk::forward<Args>(args)...),
+                                resource_deleter<T>{resource}};
+}
+}  // namespace rtk
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
+#include "core/stdlib/cstring.h"
 #include "core/stdlib/ios.h"
 #include "core/stdlib/string.h"
 #include "core/stdlib/string_view.h"
@@ -87,9 +89,11 @@ class ostream : public ios {
  private:
  public:
   // virtual
-  virtual ostream& write(const char* cstr) = 0;
+  // The `length` chars at `str`, which needn't be null-terminated
+  virtual ostream& write(const char* str, size_t length) = 0;
   virtual ostream& flush() = 0;
   // non-virtual
+  ostream& write(const char* cstr) { return write(cstr, strlen(cstr)); }
   ostream& write(uintmax_t data, bool is_signed);
   // template <typename T, typename>
   // friend ostream& operator<<(ostream& s, T data);
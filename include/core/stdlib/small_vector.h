@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stddef.h>
+#include "core/stdlib/memory.h"
+#include "core/stdlib/vector.h"
+
+namespace rtk {
+// A vector that keeps its first N elements inside the object, so short
+// lists need no allocation at all; past that it spills to `Allocator` like
+// any vector. shrink_to_fit() moves back inline once the elements fit.
+// Moving one that's still inline moves its elements one by one.
+template <typename T, size_t N, typename Allocator = heap_allocator<T>>
+using small_vector = basic_vector<T, Allocator, N>;
+}  // namespace rtk
@@ -6,8 +6,9 @@
 namespace rtk {
 class ostringstream : public ostream {
  public:
-  ostream& write(const char* data) override {
-    str_.append(data);
+  using ostream::write;
+  ostream& write(const char* data, size_t length) override {
+    str_.append(string_view{data, length});
     return *this;
   }
   ostream& flush() override { return *this; }
@@ -8,16 +8,23 @@
 #include "core/stdlib/utility.h"
 
 namespace rtk {
-class string;
+template <typename Allocator>
+class basic_string;
+using string = basic_string<heap_allocator<char>>;
 class string_view;
 constexpr size_t kMaxShortLen = 23;
 
-class string {
+// Long strings' buffers come from `Allocator` (see heap_allocator), e.g. a
+// resource_allocator<char> to build strings in an Arena
+template <typename Allocator>
+class basic_string : private policy_holder<Allocator> {
+  using Holder = policy_holder<Allocator>;
+
   union {
-    struct {  // 8 + 16 bytes
+    struct {  // 8 + 8 bytes
       bool is_short_ : 1;
       size_t len_ : 63;
-      unique_ptr<char[]> cstr_;
+      char* cstr_;  // len_ + 1 bytes from the allocator
     };
     // For short buffer optimization
     struct {  // 1 + 23 bytes
@@ -28,48 +35,68 @@ class string {
   };
 
  public:
-  string() : is_short1_{true}, shortlen_{0}, shortstr_{} {}
-  string(const char* cstr) : string() {
+  basic_string() : is_short1_{true}, shortlen_{0}, shortstr_{} {}
+  explicit basic_string(const Allocator& allocator) : basic_string() {
+    static_cast<Holder&>(*this) = Holder{allocator};
+  }
+  basic_string(const char* cstr, const Allocator& allocator = Allocator{})
+      : basic_string(allocator) {
     size_t len = rtk::strlen(cstr);
     copy_cstr(cstr, len);
   }
-  string(string_view& sv) : string() { copy_cstr(sv.c_str(), sv.length()); }
-  string(const string& other) : string() { *this = other; }
-  string(string&& other) noexcept : string() { swap(*this, other); }
-  string& operator=(const string& other) {
+  basic_string(string_view& sv, const Allocator& allocator = Allocator{})
+      : basic_string(allocator) {
+    copy_cstr(sv.c_str(), sv.length());
+  }
+  basic_string(const basic_string& other)
+      : basic_string(other.get_allocator()) {
+    *this = other;
+  }
+  basic_string(basic_string&& other) noexcept
+      : basic_string(other.get_allocator()) {
+    *this = move(other);
+  }
+  basic_string& operator=(const basic_string& other) {
     if (this == &other)
       return *this;
     copy_cstr(other.c_str(), other.length());
     return *this;
   }
-  string& operator=(string&& other) noexcept {
+  // Takes over the other's buffer, and with it its allocator
+  basic_string& operator=(basic_string&& other) noexcept {
     if (this == &other)
       return *this;
     if (other.is_short_) {
       copy_cstr(other.c_str(), other.length());
     } else {
+      reset();
+      static_cast<Holder&>(*this) = static_cast<Holder&>(other);
       is_short_ = false;
       len_ = other.len_;
-      cstr_ = move(other.cstr_);
+      cstr_ = other.cstr_;
+      other.is_short_ = true;  // the buffer isn't its to free anymore
     }
     other.reset();
     return *this;
   }
-  friend void swap(string& a, string& b) {
+  friend void swap(basic_string& a, basic_string& b) {
     // Use move assign manually to guarantee behavior
-    string temp = move(a);
+    basic_string temp = move(a);
     a = move(b);
     b = move(temp);
   }
   constexpr operator string_view() const { return {c_str(), length()}; }
-  const char* c_str() const { return is_short_ ? shortstr_ : cstr_.get(); }
+  constexpr const char* c_str() const { return is_short_ ? shortstr_ : cstr_; }
   char* c_str() { return const_cast<char*>(as_const(*this).c_str()); }
-  size_t length() const { return is_short_ ? shortlen_ : len_; }
-  virtual ~string() { reset(); }
+  constexpr size_t length() const { return is_short_ ? shortlen_ : len_; }
+  virtual ~basic_string() { reset(); }
+
+  // A copy for stateless allocators
+  decltype(auto) get_allocator() const { return Holder::policy(); }
 
-  string& operator+=(string_view other) { return append(other); }
-  string operator+(string_view other) {
-    string start;
+  basic_string& operator+=(string_view other) { return append(other); }
+  basic_string operator+(string_view other) {
+    basic_string start{get_allocator()};
     auto len = length();
     auto otherlen = other.length();
     auto newlen = len + otherlen;
@@ -78,35 +105,40 @@ class string {
       start.append(other);
       return start;
     }
-    char* ptr = new char[newlen + 1];
+    char* ptr = get_allocator().allocate(newlen + 1);
+    if (ptr == nullptr)
+      return start;  // out of mem?
     strncpy(ptr, c_str(), len);
     strncpy(ptr + len, other.c_str(), otherlen + 1);
     start.is_short_ = false;
     start.len_ = newlen;
-    start.cstr_ = {ptr, newlen + 1};
+    start.cstr_ = ptr;
     return start;
   }
 
-  string& append(string_view other) {
+  basic_string& append(string_view other) {
     const auto len = length();
     const auto otherlen = other.length();
     const auto newlen = len + otherlen;
     const auto need_buffer = len + otherlen > kMaxShortLen - 1;
     // Create a new buffer if necessary
-    char* dest = need_buffer ? new char[newlen + 1] : shortstr_;
+    char* dest =
+        need_buffer ? get_allocator().allocate(newlen + 1) : shortstr_;
+    if (dest == nullptr)
+      return *this;  // out of mem?
     // Copy A to the buffer.
     if (need_buffer) {
       strncpy(dest, c_str(), len);
     }
-    // Copy B.
-    strncpy(dest + len, other.c_str(), otherlen + 1);
+    // Copy B, which needn't be null-terminated
+    memcpy(dest + len, other.c_str(), otherlen);
+    dest[newlen] = '\0';
     // Release old buffer
     if (need_buffer) {
-      if (is_short_) {
-        // Un-corrupt
-        new (&cstr_) unique_ptr<char[]>{};
+      if (!is_short_) {
+        get_allocator().deallocate(cstr_, len_ + 1);
       }
-      cstr_ = {dest, newlen + 1};
+      cstr_ = dest;
     }
     // Set properties
     is_short_ = !need_buffer;
@@ -125,7 +157,7 @@ class string {
   friend class string_tests;
   void reset() {
     if (!is_short_) {
-      cstr_.reset();
+      get_allocator().deallocate(cstr_, len_ + 1);
       is_short_ = true;
     }
     shortlen_ = 0;
@@ -136,12 +168,12 @@ class string {
     reset();
     if (len >= kMaxShortLen) {
       auto arraylen = len + 1;
-      unique_ptr<char[]> newptr(arraylen);
-      if (newptr) {
-        is_short_ = false;
-        len_ = len;
-        cstr_ = move(newptr);
-      }
+      auto newptr = get_allocator().allocate(arraylen);
+      if (newptr == nullptr)
+        return;  // out of mem? stays empty
+      is_short_ = false;
+      len_ = len;
+      cstr_ = newptr;
     } else {
       is_short_ = true;
       shortlen_ = len;
@@ -151,5 +183,5 @@ class string {
     // Ensure null terminated after strncpy for safety
     (c_str())[len] = '\0';
   }
-};  // class string
-}  // namespace rtk
\ No newline at end of file
+};  // class basic_string
+}  // namespace rtk
@@ -169,6 +169,22 @@ struct add_const<T (&)[]> {
 template <typename T>
 using add_const_t = typename add_const<T>::type;
 
+// https://en.cppreference.com/w/cpp/types/is_empty.html
+template <typename T>
+struct is_empty : public integral_constant<bool, __is_empty(T)> {};
+
+template <class T>
+static constexpr bool is_empty_v = is_empty<T>::value;
+
+// https://en.cppreference.com/w/cpp/types/is_trivially_copyable.html
+// Such types can also be moved around with memcpy and need no destructor.
+template <typename T>
+struct is_trivially_copyable
+    : public integral_constant<bool, __is_trivially_copyable(T)> {};
+
+template <class T>
+static constexpr bool is_trivially_copyable_v = is_trivially_copyable<T>::value;
+
 // https://en.cppreference.com/w/cpp/types/void_t.html
 template <typename...>
 using void_t = void;
@@ -3,98 +3,237 @@
 #include <cstddef>
 #include <cstdint>
 #include "core/status.h"
+#include "core/stdlib/freestanding/new.h"     // placement new
+#include "core/stdlib/freestanding/string.h"  // rtk::memcpy
 #include "core/stdlib/memory.h"
+#include "core/stdlib/type_traits.h"
+#include "core/stdlib/utility.h"
 
 namespace rtk {
+// Raw room for N elements inside the object; none at all for N = 0
+template <typename T, size_t N>
+class inline_storage {
+ protected:
+  T* inline_data() { return reinterpret_cast<T*>(bytes_); }
+
+ private:
+  alignas(T) unsigned char bytes_[N * sizeof(T)];
+};  // class inline_storage
+
 template <typename T>
-class vector {
-  mutable size_t size_ = 0;
-  mutable size_t initial_capacity_ = default_initial_capacity_;
-  mutable size_t capacity_ = 0;
-  mutable unique_ptr<T[]> elems_;  // resize const data
+class inline_storage<T, 0> {
+ protected:
+  T* inline_data() { return nullptr; }
+};  // class inline_storage<T, 0>
+
+// Use vector or small_vector (core/stdlib/small_vector.h).
+// Storage comes from `Allocator` (see heap_allocator), e.g. a
+// resource_allocator<T> to keep a vector in an Arena. The first
+// InlineCapacity elements live in the object itself, and only more go to
+// the allocator. Only live elements are ever constructed; spare capacity
+// stays raw memory. Trivially copyable elements are moved with memcpy.
+template <typename T, typename Allocator, size_t InlineCapacity>
+class basic_vector : private policy_holder<Allocator>,
+                     private inline_storage<T, InlineCapacity> {
+  using Holder = policy_holder<Allocator>;
+  using Inline = inline_storage<T, InlineCapacity>;
+
+  size_t size_ = 0;
+  size_t initial_capacity_ = default_initial_capacity_;
+  size_t capacity_ = InlineCapacity;
+  // [0, size_) constructed, [size_, capacity_) raw
+  T* elems_ = Inline::inline_data();
 
  public:
-  vector() : size_{0}, capacity_{0}, elems_{} {}
-  explicit vector(size_t size) : size_{size} {}
-  explicit vector(size_t size, size_t initial_capacity)
-      : size_{size}, initial_capacity_{initial_capacity} {}
+  using value_type = T;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  basic_vector() = default;
+  explicit basic_vector(const Allocator& allocator) : Holder{allocator} {}
+  // `size` value-initialized elements
+  explicit basic_vector(size_t size, const Allocator& allocator = Allocator{})
+      : Holder{allocator} {
+    resize(size);
+  }
+  explicit basic_vector(size_t size,
+                        size_t initial_capacity,
+                        const Allocator& allocator = Allocator{})
+      : Holder{allocator}, initial_capacity_{initial_capacity} {
+    resize(size);
+  }
+  basic_vector(const basic_vector& other) = delete;
+  basic_vector& operator=(const basic_vector& other) = delete;
+  basic_vector(basic_vector&& other) noexcept
+      : Holder{other.get_allocator()} {
+    *this = move(other);
+  }
+  // Takes over the other's storage and allocator. Inline elements can't be
+  // handed over, so they're moved one by one.
+  basic_vector& operator=(basic_vector&& other) noexcept {
+    if (this != &other) {
+      release();
+      static_cast<Holder&>(*this) = static_cast<Holder&>(other);
+      initial_capacity_ = other.initial_capacity_;
+      if (other.is_inline()) {
+        relocate(elems_, other.elems_, other.size_);
+      } else {
+        capacity_ = other.capacity_;
+        elems_ = other.elems_;
+        other.capacity_ = InlineCapacity;
+        other.elems_ = other.inline_data();
+      }
+      size_ = other.size_;
+      other.size_ = 0;
+    }
+    return *this;
+  }
+  ~basic_vector() { release(); }
+
+  // A copy for stateless allocators
+  decltype(auto) get_allocator() const { return Holder::policy(); }
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  bool empty() const { return size_ == 0; }
+  const T* data() const { return elems_; }
+  T* data() { return elems_; }
+
+  const_iterator begin() const { return elems_; }
+  const_iterator end() const { return elems_ + size_; }
+  iterator begin() { return elems_; }
+  iterator end() { return elems_ + size_; }
 
-  const size_t size() const { return size_; }
   const T& operator[](size_t index) const {
     if (index >= size_) {
       TRAP(OutOfBounds);
     }
-    if (capacity_ == 0) {
-      resize(size_);  // accessing empty vector before buffer is created
-    }
     return elems_[index];
   }
   T& operator[](size_t index) {
     return const_cast<T&>(rtk::as_const(*this)[index]);
   }
+  // Caller responsible for checking empty()
+  const T& front() const { return (*this)[0]; }
+  T& front() { return (*this)[0]; }
+  const T& back() const { return (*this)[size_ - 1]; }
+  T& back() { return (*this)[size_ - 1]; }
+
   template <typename... Args>
   void emplace_back(Args&&... args) {
-    auto old_size = size_;
-    resize(size_ + 1);
-    if (size_ <= old_size) {
-      TRAP(OutOfMemory);
+    if (size_ < capacity_) {
+      new (elems_ + size_) T(rtk::forward<Args>(args)...);
+      size_++;
       return;
     }
-    T* ptr = elems_.get() + old_size;
-    new (ptr) T{move(args)...};
-  }
-  // Push by moving
-  void push_back(T&& elem) {
-    auto old_size = size_;
-    resize(size_ + 1);
-    if (size_ <= old_size) {
+    // The arguments may live in the old storage, so build the new element
+    // before moving the old ones out
+    auto new_capacity = computeGrowth(size_ + 1);
+    auto ptr = get_allocator().allocate(new_capacity);
+    if (ptr == nullptr) {
       TRAP(OutOfMemory);
-      return;
+      return;  // leave unmodified
     }
-    elems_[old_size] = move(elem);
+    new (ptr + size_) T(rtk::forward<Args>(args)...);
+    adopt(ptr, new_capacity);
+    size_++;
   }
+  // Push by moving
+  void push_back(T&& elem) { emplace_back(move(elem)); }
   // Push by copying
-  void push_back(const T& elem) {
-    auto old_size = size_;
-    resize(size_ + 1);
-    if (size_ <= old_size) {
-      TRAP(OutOfMemory);
-      return;
-    }
-    elems_[old_size] = elem;
-  }
+  void push_back(const T& elem) { emplace_back(elem); }
   void pop_back() {
     if (size_ == 0)
       return;
-    resize(size_ - 1);
+    destroy(elems_ + size_ - 1, 1);
+    size_--;
   }
-  void resize(size_t new_size) const {  // not logically mutating the list
+
+  // Inserts before `pos`; returns where the new element ended up
+  template <typename... Args>
+  iterator emplace(const_iterator pos, Args&&... args) {
+    const auto index = static_cast<size_t>(pos - elems_);
+    if (index >= size_) {
+      emplace_back(rtk::forward<Args>(args)...);
+      return elems_ + size_ - 1;
+    }
+    // Made first, in case the arguments refer to elements about to move
+    T value = T(rtk::forward<Args>(args)...);
+    emplace_back(move(elems_[size_ - 1]));
+    for (auto i = size_ - 2; i > index; i--) {
+      elems_[i] = move(elems_[i - 1]);
+    }
+    elems_[index] = move(value);
+    return elems_ + index;
+  }
+  iterator insert(const_iterator pos, T&& elem) {
+    return emplace(pos, move(elem));
+  }
+  iterator insert(const_iterator pos, const T& elem) {
+    return emplace(pos, elem);
+  }
+  // Removes [first, last); returns the element after them
+  iterator erase(const_iterator first, const_iterator last) {
+    const auto index = static_cast<size_t>(first - elems_);
+    const auto count = static_cast<size_t>(last - first);
+    if (count == 0 || index + count > size_)
+      return elems_ + index;
+    for (auto i = index; i + count < size_; i++) {
+      elems_[i] = move(elems_[i + count]);
+    }
+    destroy(elems_ + size_ - count, count);
+    size_ -= count;
+    return elems_ + index;
+  }
+  iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+
+  void clear() {
+    destroy(elems_, size_);
+    size_ = 0;
+  }
+  // New elements are value-initialized
+  void resize(size_t new_size) {
     if (new_size > size_) {
-      // reserve capacity
-      grow(new_size);
-    } else if (new_size < size_) {
-      // Retire old objects
-      for (auto i = new_size; i < size_; i++) {
-        elems_[i].~T();
+      if (new_size > capacity_ && !reallocate(computeGrowth(new_size)))
+        return;
+      for (auto i = size_; i < new_size; i++) {
+        new (elems_ + i) T{};
       }
-      size_ = new_size;
+    } else {
+      destroy(elems_ + new_size, size_ - new_size);
     }
+    size_ = new_size;
   }
-  void reserve(size_t capacity) {  // not logically mutating the list
+  void reserve(size_t capacity) {
     if (capacity == 0) {
       return;
     }
     if (capacity_ == 0) {
       // Lazy reserve--only setting initial capacity!
       initial_capacity_ = capacity;
-    } else {
+    } else if (capacity > capacity_) {
       // grow only
-      grow(capacity);
+      reallocate(capacity);
+    }
+  }
+  // Gives back spare capacity, moving back inline when the elements fit
+  void shrink_to_fit() {
+    if (is_inline() || size_ == capacity_)
+      return;
+    if (size_ <= InlineCapacity) {
+      auto ptr = elems_;
+      relocate(Inline::inline_data(), ptr, size_);
+      get_allocator().deallocate(ptr, capacity_);
+      elems_ = Inline::inline_data();
+      capacity_ = InlineCapacity;
+    } else {
+      reallocate(size_);
     }
   }
 
  private:
   friend class vector_tests;
+  using Inline::inline_data;
 
   static constexpr size_t num_ = 3;
   static constexpr size_t denom_ = 2;
@@ -107,59 +246,71 @@ class vector {
   static_assert(default_initial_capacity_ > 0,
                 "Must have capacity of at least 1");
 
-  template <size_t num, size_t denom>
-  size_t computeGrowth() const {
+  // Capacity to grow to for at least `requested_size` elements
+  size_t computeGrowth(size_t requested_size) const {
     auto new_capacity =
-        capacity_ == 0 ? initial_capacity_ : num * capacity_ / denom;
-    if (new_capacity == capacity_) {
-      new_capacity += 1;
-    }
-    return new_capacity;
-  }
-  size_t computeGrowth() const { return computeGrowth<num_, denom_>(); }
-  // Returns whether a resize was needed
-  bool grow(size_t requested_size) const {  // doesn't logically affect data
-    // Start using existing capacity
-    auto new_capacity = capacity_;
-    // See if we can bump up to the next ideal capacity
-    if (requested_size > capacity_) {
-      new_capacity = computeGrowth();
-    }
-    // See if we need more than a small bump
-    if (requested_size > new_capacity) {
-      new_capacity = requested_size;
-    }
-    // See if we grew at all
+        capacity_ == 0 ? initial_capacity_ : num_ * capacity_ / denom_;
     if (new_capacity <= capacity_) {
-      size_ = requested_size;
-      return false;
+      new_capacity = capacity_ + 1;
     }
-    // Make a bigger array
-    unique_ptr<T[]> new_elems(new_capacity);
-    // Check success
-    if (!new_elems) {
+    return requested_size > new_capacity ? requested_size : new_capacity;
+  }
+
+  static void destroy(T* first, size_t count) {
+    if constexpr (!is_trivially_copyable_v<T>) {
+      for (size_t i = 0; i < count; i++) {
+        first[i].~T();
+      }
+    }
+  }
+  // Moves `count` elements into raw memory, leaving `src` raw
+  static void relocate(T* dest, T* src, size_t count) {
+    if constexpr (is_trivially_copyable_v<T>) {
+      if (count > 0) {
+        rtk::memcpy(dest, src, count * sizeof(T));
+      }
+    } else {
+      for (size_t i = 0; i < count; i++) {
+        new (dest + i) T(move(src[i]));
+        src[i].~T();
+      }
+    }
+  }
+  bool is_inline() const {
+    return InlineCapacity > 0 &&
+           elems_ == const_cast<basic_vector*>(this)->inline_data();
+  }
+  // Moves the elements into `ptr` and frees the old storage
+  void adopt(T* ptr, size_t new_capacity) {
+    relocate(ptr, elems_, size_);
+    if (elems_ != nullptr && !is_inline()) {
+      get_allocator().deallocate(elems_, capacity_);
+    }
+    elems_ = ptr;
+    capacity_ = new_capacity;
+  }
+  // Returns whether the storage was replaced
+  bool reallocate(size_t new_capacity) {
+    auto ptr = get_allocator().allocate(new_capacity);
+    if (ptr == nullptr) {
       TRAP(OutOfMemory);
       return false;  // leave unmodified
     }
-    // Capacity has been increased
-    capacity_ = new_capacity;
-    // Use fast indexing
-    auto prevptr = elems_.get();
-    auto ptr = new_elems.get();
-    // Copy or move items
-    for (auto i = 0; i < size_; i++) {
-      ptr[i] = move(prevptr[i]);
-    }
-    // Need to initialize remaining?
-    for (auto i = size_; i < new_capacity; i++) {
-      new (ptr + i) T{};
-    }
-    // Move, and old pointer deallocates array
-    elems_ = move(new_elems);
-    // New size is now correct
-    size_ = requested_size;
-    // We resized
+    adopt(ptr, new_capacity);
     return true;
   }
-};  // class vector
-}  // namespace rtk
\ No newline at end of file
+  // Back to empty, with only the inline capacity
+  void release() {
+    destroy(elems_, size_);
+    size_ = 0;
+    if (elems_ == nullptr || is_inline())
+      return;
+    get_allocator().deallocate(elems_, capacity_);
+    elems_ = inline_data();
+    capacity_ = InlineCapacity;
+  }
+};  // class basic_vector
+
+template <typename T, typename Allocator = heap_allocator<T>>
+using vector = basic_vector<T, Allocator, 0>;
+}  // namespace rtk
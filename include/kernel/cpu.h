@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "asm.h"
+
+namespace k {
+// CPUs with an index at or above this share the slow paths of per-CPU caches
+constexpr size_t kMaxCpus = 64;
+
+constexpr uint32_t kMsrGsBase = 0xC0000101;
+
+// Per-CPU block that GS points at on every CPU. asm.S reads fields by offset.
+struct CpuLocal {
+  CpuLocal* self;
+  uint32_t index;
+};
+static_assert(offsetof(CpuLocal, index) == 8, "see current_cpu_index in asm.S");
+
+// CPUID features the kernel cares about
+struct CpuFeatures {
+  bool hugePages;         // 1 GiB pages (PDPE1GB)
+  bool globalPages;       // PGE
+  bool pcid;              // PCID
+  bool invpcid;           // INVPCID
+  bool erms;              // fast rep movsb/stosb (ERMS)
+  size_t lastLevelCache;  // bytes, 0 if CPUID doesn't say
+};
+
+// in kernel/cpu.cpp
+// Reads CPUID into Features(); call once on the boot CPU
+void DetectCpuFeatures();
+const CpuFeatures& Features();
+
+// in kernel/lib/c/runtime_support.cpp
+// Picks the memcpy and memset variants for the CPU, and the size from which
+// fills skip the caches; call once after DetectCpuFeatures(). Until then
+// they use only SSE2.
+void SelectMemoryRoutines();
+
+// Turns on global pages and PCIDs where supported; call on each CPU after
+// DetectCpuFeatures()
+void InitCpuPaging();
+
+// Points GS at the CpuLocal block for `index`; call once on each CPU as it
+// comes up, before anything asks for the current CPU.
+void InitCpuLocal(uint32_t index);
+
+// Index of the executing CPU, or kMaxCpus for CPUs past the limit.
+// Only stable while interrupts are disabled.
+inline uint32_t CurrentCpu() {
+  return current_cpu_index();
+}
+}  // namespace k
@@ -1,16 +1,156 @@
 #pragma once
 
-#include "di.h"
-#include "kernel.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/status.h"
+#include "core/stdlib/memory_resource.h"
+#include "kernel/paging.h"
+#include "kernel/profile.h"
+#include "kernel/sync.h"
 
 namespace k {
-class SystemAllocator {
+class KernelContext;
+
+// General purpose kernel allocator, behind operator new and delete
+class Allocator {
  public:
-  Allocator(ServiceContext& sc) : sc_{sc} {}
-  virtual ~Allocator() noexcept = 0;
+  Allocator(const Allocator& other) = delete;
+  Allocator(Allocator&& other) = delete;
+  Allocator& operator=(const Allocator& other) = delete;
+  Allocator& operator=(Allocator&& other) = delete;
+
+  // At least `size` bytes, aligned to 16. Profiling charges it to `site`,
+  // or to the caller when that's nullptr.
+  virtual rtk::StatusOr<void*> allocate(size_t size,
+                                        const void* site = nullptr) const = 0;
+  // Takes back memory from allocate(); nullptr is ignored
+  virtual void free(void* ptr) const = 0;
+  // Allocation statistics, for allocators that keep them
+  virtual const AllocationProfiler* profiler() const { return nullptr; }
 
  protected:
-  ServiceContext& sc_;
-};  // class heap
-inline Allocator::~Allocator() noexcept {}
-}  // namespace k
\ No newline at end of file
+  Allocator() = default;
+};  // class Allocator
+
+// Size-class slab allocator. Classes step by a quarter of each power of two
+// (x1, x1.25, x1.5, x1.75) up to kMaxSmallSize. A slab is one page: a header
+// followed by objects of one class, with its own free list. Each class lists
+// its partly used slabs, so small allocations and frees are O(1), and keeps
+// one empty slab around before giving pages back. Bigger allocations get
+// their own demand-paged heap reservation.
+//
+// In front of the slabs, each CPU keeps a loaded and a previous magazine of
+// free objects per class, used with only interrupts disabled. A CPU trades
+// whole magazines with the class's depot when both run out (or fill up), so
+// most calls touch nothing shared and take no lock.
+//
+// Profiling counts small allocations by size class; large ones share the
+// last class, kClassCount.
+class SlabAllocator final : public Allocator {
+ public:
+  static constexpr size_t kAlignment = 16;
+  // 1024-byte objects would fit only three to a slab, wasting a quarter
+  // of it, so sizes above 896 go to allocateLarge
+  static constexpr size_t kMaxSmallSize = 896;
+  static constexpr int kClassCount = 19;
+  static constexpr size_t kMagazineRounds = 15;
+  // Full magazines a depot holds before it returns objects to the slabs
+  static constexpr size_t kDepotLimit = 16;
+
+  // Bytes per object in class `index`: 16, 32, 48, 64, 80, 96, 112, 128,
+  // 160, ..., 896
+  static constexpr size_t classSize(int index) {
+    if (index < 4)
+      return (index + 1) * kAlignment;
+    const auto step = index - 4;
+    return ((size_t)64 << (step / 4)) * (5 + step % 4) / 4;
+  }
+
+  SlabAllocator(const KernelContext& kernel) : kernel_{kernel} {}
+  rtk::StatusOr<void*> allocate(size_t size,
+                                const void* site = nullptr) const override;
+  void free(void* ptr) const override;
+  const AllocationProfiler* profiler() const override { return &profiler_; }
+
+ private:
+  // Every slab and large block starts with a header on a page boundary,
+  // and the memory handed out never does, so a pointer's page finds it
+  static constexpr size_t kHeaderSize = 64;
+  static constexpr uint32_t kSlabMagic = 0x534C4142;   // "SLAB"
+  static constexpr uint32_t kLargeMagic = 0x4C524745;  // "LRGE"
+
+  struct FreeObject {
+    FreeObject* next;
+  };
+  struct Slab {
+    uint32_t magic;
+    uint16_t sizeClass;
+    uint16_t inUse;
+    FreeObject* free;
+    Slab* prev;  // partial list
+    Slab* next;
+    uintptr_t frame;
+    PageSet pages;  // large blocks: the whole reservation
+  };
+  static_assert(sizeof(Slab) <= kHeaderSize);
+
+  struct Magazine {
+    Magazine* next;  // depot lists
+    size_t rounds;
+    void* objects[kMagazineRounds];
+  };
+  struct CpuCache {
+    Magazine* loaded;
+    Magazine* previous;
+  };
+  struct alignas(64) CpuCaches {
+    CpuCache classes[kClassCount];
+  };
+
+  // Slab lists and depot of one class, under one lock
+  struct alignas(64) SizeClass {
+    SpinLock lock;
+    Slab* partial;
+    Slab* empty;
+    Magazine* full;
+    Magazine* emptyMagazines;
+    size_t fullCount;
+  };
+
+  const KernelContext& kernel_;
+  mutable SizeClass classes_[kClassCount] = {};
+  mutable CpuCaches cpus_[kMaxCpus] = {};
+  const AllocationProfiler profiler_{"heap", kClassCount + 1};
+
+  static int classFor(size_t size);
+  // Call with the class lock held
+  rtk::StatusOr<Slab*> newSlab(int index) const;
+  void releaseSlab(Slab* slab) const;
+  static void link(SizeClass& sizeClass, Slab* slab);
+  static void unlink(SizeClass& sizeClass, Slab* slab);
+  void freeToSlab(void* ptr) const;
+  // Takes the class lock
+  rtk::StatusOr<void*> allocateFromSlab(int index) const;
+  rtk::StatusOr<void*> allocateLarge(size_t size) const;
+
+  // Magazine layer; call with interrupts disabled. nullptr or false when
+  // the slabs have to handle the call instead.
+  CpuCache* localCache(int index) const;
+  void* popLocal(int index) const;
+  bool pushLocal(int index, void* ptr) const;
+  Magazine* exchangeEmpty(int index, Magazine* full) const;
+};  // class SlabAllocator
+
+// Whole pages of demand-paged heap, e.g. as the upstream of an rtk::Arena.
+// Each allocation is its own reservation, backed only as it's touched.
+class PageResource final : public rtk::memory_resource {
+ public:
+  PageResource(const DemandPagedHeap& heap) : heap_{heap} {}
+  void* allocate(size_t bytes, size_t alignment) override;
+  void deallocate(void* ptr, size_t bytes, size_t alignment) override;
+
+ private:
+  const DemandPagedHeap& heap_;
+};  // class PageResource
+}  // namespace k
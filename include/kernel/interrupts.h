@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace k {
+constexpr int kPageFaultVector = 14;
+
+// Page fault error code bits
+constexpr uint64_t kPageFaultPresent = 1ULL << 0;  // protection violation
+constexpr uint64_t kPageFaultWrite = 1ULL << 1;
+constexpr uint64_t kPageFaultUser = 1ULL << 2;
+constexpr uint64_t kPageFaultReserved = 1ULL << 3;  // reserved bit set
+constexpr uint64_t kPageFaultFetch = 1ULL << 4;
+
+// in kernel/interrupts.cpp
+// Loads the kernel IDT on the current CPU. Page faults go to the kernel
+// heap; every other exception halts the CPU. Call once the kernel context
+// exists.
+void InitInterrupts();
+}  // namespace k
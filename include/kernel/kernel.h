@@ -4,7 +4,9 @@
 #include <stdint.h>
 
 #include "core/status.h"
+#include "kernel/heap.h"
 #include "kernel/paging.h"
+#include "kernel/pcid.h"
 
 namespace k {
 // forward declarations
@@ -27,6 +29,10 @@ class KernelContext {
   const virtual PhysicalMemoryAllocator& pageAllocator() const = 0;
   const virtual VirtualMemoryAllocator& virtualMemoryAllocator() const = 0;
   const virtual PageTables& pageTables() const = 0;
+  const virtual PcidAllocator& pcidAllocator() const = 0;
+  const virtual DemandPagedHeap& heap() const = 0;
+  // heap.h
+  const virtual Allocator& allocator() const = 0;
 
  protected:
   KernelContext() {};
@@ -51,13 +57,20 @@ class DefaultKernelContext final : public KernelContext {
     return virtualMemoryAllocator_;
   }
   const PageTables& pageTables() const override { return pageTables_; }
+  const PcidAllocator& pcidAllocator() const override { return pcids_; }
+  const DemandPagedHeap& heap() const override { return heap_; }
+  const Allocator& allocator() const override { return allocator_; }
 
  protected:
   const DefaultKernelMemoryLayout memoryLayout_;
-  const DefaultPhysicalMemoryAllocator pageAllocator_;
+  const KernelPhysicalMemoryAllocator pageAllocator_;
+  const PerCpuPageCache pageCache_;
   const PhysicalMemoryAllocator* pageAllocatorPtr_;
   const DefaultVirtualMemoryAllocator virtualMemoryAllocator_;
   const RecursivePageTables pageTables_;
+  const PcidAllocator pcids_;
+  const DemandPagedHeap heap_;
+  const SlabAllocator allocator_;
 };  // class DefaultKernelContext
 
 class KernelBootstrapper {
@@ -68,6 +81,7 @@ class KernelBootstrapper {
   KernelBootstrapper& operator=(KernelBootstrapper&& other) = delete;
 
   virtual MemoryBootstrapper& memoryBootstrapper() = 0;
+  virtual size_t cpuCount() const = 0;
 
  protected:
   KernelBootstrapper() {}
@@ -6,6 +6,9 @@
 #include "core/stdlib/freestanding/string.h"
 #include "core/stdlib/memory.h"
 #include "core/stdlib/utility.h"
+#include "kernel/cpu.h"
+#include "kernel/profile.h"
+#include "kernel/sync.h"
 
 namespace k {
 class KernelMemoryLayout;
@@ -13,13 +16,17 @@ enum class PageAttr : uintptr_t;
 class PageEntry;
 class PageTable;
 class PhysicalMemoryAllocator;
+class DefaultPhysicalMemoryAllocator;
+class BuddyPhysicalMemoryAllocator;
 class VirtualMemoryAllocator;
 class MemoryBootstrapper;
 class KernelBootstrapper;
 
 class KernelContext;
 
-constexpr size_t kPageSize = 0x1000;  // 4096 bytes
+constexpr size_t kPageSize = 0x1000;          // 4096 bytes
+constexpr size_t kLargePageSize = 0x200000;   // 2 MiB, PD level
+constexpr size_t kHugePageSize = 0x40000000;  // 1 GiB, PDP level
 
 struct PageSet {
   size_t pageSize;
@@ -27,12 +34,22 @@ struct PageSet {
   size_t count;
 };
 
+// in kernel/pageops.cpp
+// Page-aligned, writable 4 KiB pages. Each goes through the variant that
+// SelectPageRoutines() timed fastest.
+void ZeroPage(uintptr_t address);
+void ZeroPages(PageSet pages);
+void CopyPage(uintptr_t dest, uintptr_t src);
+// Times each variant on pages borrowed from `kernel` and given back; call
+// once on the boot CPU. Until then it's rep stosq and rep movsq.
+void SelectPageRoutines(const KernelContext& kernel);
+
 class KernelMemoryLayout {
  public:
   KernelMemoryLayout(uintptr_t userStart, uintptr_t userEnd,
                      uintptr_t kernelStart, uintptr_t kernelEnd,
                      uintptr_t identityStart, uintptr_t identityEnd,
-                     uintptr_t heapStart, uintptr_t heapEnd,
+                     uintptr_t scratchStart, uintptr_t heapStart, uintptr_t heapEnd,
                      uintptr_t kernelImageStart, uintptr_t mmapsStart,
                      uintptr_t mmapsEnd, uintptr_t pgtablesStart,
                      uintptr_t pgtablesEnd, uintptr_t pgtableAddr)
@@ -42,6 +59,7 @@ class KernelMemoryLayout {
         kernelEnd_{kernelEnd},
         identityStart_{identityStart},
         identityEnd_{identityEnd},
+        scratchStart_{scratchStart},
         heapStart_{heapStart},
         heapEnd_{heapEnd},
         kernelImageStart_{kernelImageStart},
@@ -56,6 +74,9 @@ class KernelMemoryLayout {
   uintptr_t kernelSpaceEnd() const { return kernelEnd_; }
   uintptr_t identityPagingStart() const { return identityStart_; }
   uintptr_t identityPagingEnd() const { return identityEnd_; }
+  // One page per CPU, up to and including kMaxCpus, for the page tables to
+  // map frames at while they work on them
+  uintptr_t scratchPagesStart() const { return scratchStart_; }
   uintptr_t heapStart() const { return heapStart_; }
   uintptr_t heapEnd() const { return heapEnd_; }
   uintptr_t kernelImageStart() const { return kernelImageStart_; }
@@ -72,6 +93,7 @@ class KernelMemoryLayout {
   const uintptr_t kernelEnd_;
   const uintptr_t identityStart_;
   const uintptr_t identityEnd_;
+  const uintptr_t scratchStart_;
   const uintptr_t heapStart_;
   const uintptr_t heapEnd_;
   const uintptr_t kernelImageStart_;
@@ -91,7 +113,8 @@ class DefaultKernelMemoryLayout : public KernelMemoryLayout {
             0xFFFF800000000000ULL,  // kernel space start:    -128 TiB
             0xFFFFFFFFFFFFFFFFULL,  // kernel space end:      -
             0xFFFF800000000000ULL,  // identity maps start:   -128 TiB
-            0xFFFF800FFFFFFFFFULL,  // identity maps end:     -127 TiB
+            0xFFFF800FFFDFFFFFULL,  // identity maps end:     -127 TiB - 2 MiB
+            0xFFFF800FFFE00000ULL,  // scratch pages start:   -127 TiB - 2 MiB
             0xFFFF801000000000ULL,  // heap start             -127 TiB
             0xFFFFFEFFFFFFFFFFULL,  // heap end               -  1 TiB
             0xFFFFFF0000000000ULL,  // kernel image start     -  1 TiB
@@ -112,6 +135,7 @@ enum class PageAttr : uintptr_t {
   Accessed = (1ULL << 5),
   Dirty = (1ULL << 6),
   PAT = (1ULL << 7),
+  PS = (1ULL << 7),  // PD/PDP entries: maps a 2 MiB/1 GiB page, not a table
   Global = (1ULL << 8),
   NX = (1ULL << 63),  // Only if EFER.NXE is enabled
 };  // enum class PageAttr
@@ -219,6 +243,8 @@ class __attribute__((aligned(8))) __attribute__((packed)) PageEntry {
   void setPat(bool set) volatile { pat_ = set; }
   void setPat() volatile { setPat(true); }
   void clearPat() volatile { setPat(false); }
+  // PS occupies the PAT bit in PD and PDP entries
+  bool ps() const volatile { return pat_; }
   bool global() const volatile { return global_; }
   void setGlobal(bool set) volatile { global_ = set; }
   void setGlobal() volatile { setGlobal(true); }
@@ -280,6 +306,8 @@ inline PageLevel operator--(PageLevel& level, int)  // postfix
 
 class __attribute__((aligned(4096))) __attribute__((packed)) PageTable {
  public:
+  static constexpr int kNumEntries = kPageSize / sizeof(PageEntry);
+
   rtk::StatusOr<volatile PageEntry*> getEntry(size_t index) volatile {
     if (index >= kNumEntries) {
       return rtk::StatusCode::OutOfBounds;
@@ -296,12 +324,52 @@ class __attribute__((aligned(4096))) __attribute__((packed)) PageTable {
 
     return rtk::StatusCode::Ok;
   }
-  void clear() volatile { rtk::memset((void*)this, 0, sizeof(*this)); }
+  void clear() volatile { ZeroPage(reinterpret_cast<uintptr_t>(this)); }
+  // Unchecked access for loops that already know their bounds
+  volatile PageEntry& operator[](size_t index) volatile {
+    return entries_[index];
+  }
 
  private:
-  static constexpr int kNumEntries = kPageSize / sizeof(PageEntry);
   volatile PageEntry entries_[kNumEntries];
 };  // class PageTable
+static_assert(sizeof(PageTable) == kPageSize, "clear() zeroes one page");
+
+// Collects virtual addresses whose translations went stale so they can be
+// flushed together once the page tables are consistent again. Past
+// kMaxPages a single full flush is cheaper than that many invlpg.
+class TlbFlushBatch final {
+ public:
+  static constexpr size_t kMaxPages = 32;
+
+  TlbFlushBatch() = default;
+  ~TlbFlushBatch() { flush(); }
+  TlbFlushBatch(const TlbFlushBatch& other) = delete;
+  TlbFlushBatch& operator=(const TlbFlushBatch& other) = delete;
+
+  // Any address inside a large page flushes the whole page
+  void add(uintptr_t vaddr) {
+    if (count_ < kMaxPages) {
+      pages_[count_] = vaddr;
+    }
+    count_++;
+  }
+  void flush() {
+    if (count_ > kMaxPages) {
+      // A CR3 reload would keep global kernel pages
+      flush_tlb_all();
+    } else {
+      for (size_t i = 0; i < count_; i++) {
+        invalidate_page(pages_[i]);
+      }
+    }
+    count_ = 0;
+  }
+
+ private:
+  uintptr_t pages_[kMaxPages];
+  size_t count_ = 0;
+};  // class TlbFlushBatch
 
 class PageTables {
  public:
@@ -312,24 +380,58 @@ class PageTables {
 
   const PageTable& root() { return pml4_; }
 
+  // Bytes mapped by one entry at `level`
+  static constexpr size_t levelPageSize(PageLevel level) {
+    return kPageSize << (9 * ((int)level - 1));
+  }
+
   virtual rtk::StatusCode map(uintptr_t vaddr, uintptr_t paddr,
                               PageAttr attributes) const = 0;
+  // Maps one 2 MiB (PD) or 1 GiB (PDP) page; both addresses must be aligned
+  // to it. NotImplemented if the level isn't supported, AlreadyExists if a
+  // table of smaller pages is already in its place.
+  virtual rtk::StatusCode mapLarge(PageLevel level, uintptr_t vaddr,
+                                   uintptr_t paddr, PageAttr attributes) const {
+    return rtk::StatusCode::NotImplemented;
+  }
+  // Maps `count` 4 KiB pages, using the largest pages alignment allows
   rtk::StatusCode map(size_t count, uintptr_t vaddr, uintptr_t paddr,
-                      PageAttr attributes) const {
-    for (size_t i = 0; i < count; i++) {
-      auto status = map(vaddr, paddr, attributes);
-      if (status != rtk::StatusCode::Ok) {
-        return status;
-      }
-      vaddr += kPageSize;
-      paddr += kPageSize;
-    }
-    return rtk::StatusCode::Ok;
+                      PageAttr attributes) const;
+
+  // Removes the mappings for `count` pages from vaddr, skipping holes.
+  // Large pages only partly in the range are split first. Tables left empty
+  // go back to the page allocator. Stale translations are added to `flush`.
+  virtual rtk::StatusCode unmap(size_t count, uintptr_t vaddr,
+                                TlbFlushBatch& flush) const = 0;
+  rtk::StatusCode unmap(size_t count, uintptr_t vaddr) const {
+    TlbFlushBatch flush;
+    return unmap(count, vaddr, flush);
+  }
+  // Replaces the attributes of the mapped pages in the range, like unmap
+  virtual rtk::StatusCode protect(size_t count, uintptr_t vaddr,
+                                  PageAttr attributes,
+                                  TlbFlushBatch& flush) const = 0;
+  rtk::StatusCode protect(size_t count, uintptr_t vaddr,
+                          PageAttr attributes) const {
+    TlbFlushBatch flush;
+    return protect(count, vaddr, attributes, flush);
   }
+  // Physical address vaddr maps to, or ValueNotPresent
+  virtual rtk::StatusOr<uintptr_t> translate(uintptr_t vaddr) const = 0;
 
  protected:
   PageTables(uintptr_t pgtablePaddr, uintptr_t pgtableVaddr)
       : pml4_{*(PageTable*)pgtableVaddr}, pml4Paddr_{pgtablePaddr} {}
+  // Maps between 1 and `count` 4 KiB pages from vaddr; returns how many.
+  // One at a time unless overridden.
+  virtual rtk::StatusOr<size_t> mapLeaves(size_t count, uintptr_t vaddr,
+                                          uintptr_t paddr,
+                                          PageAttr attributes) const {
+    auto status = map(vaddr, paddr, attributes);
+    if (status != rtk::StatusCode::Ok)
+      return status;
+    return size_t{1};
+  }
   PageTable& pml4_;
   const uintptr_t pml4Paddr_;
 };  // class PageTables
@@ -337,17 +439,34 @@ class PageTables {
 class RecursivePageTables final : public PageTables {
  public:
   RecursivePageTables(const KernelMemoryLayout& layout,
-                      const PhysicalMemoryAllocator& pallocator,
+                      const KernelContext& kernel,
                       // const VirtualMemoryAllocator& vallocator,
                       const MemoryBootstrapper& memoryBootstrapper);
 
   rtk::StatusCode map(uintptr_t virtAddr, uintptr_t physAddr,
                       PageAttr attributes) const override;
+  rtk::StatusCode mapLarge(PageLevel level, uintptr_t virtAddr,
+                           uintptr_t physAddr,
+                           PageAttr attributes) const override;
+  rtk::StatusCode unmap(size_t count, uintptr_t virtAddr,
+                        TlbFlushBatch& flush) const override;
+  rtk::StatusCode protect(size_t count, uintptr_t virtAddr,
+                          PageAttr attributes,
+                          TlbFlushBatch& flush) const override;
+  rtk::StatusOr<uintptr_t> translate(uintptr_t virtAddr) const override;
+  using PageTables::map;
+  using PageTables::protect;
+  using PageTables::unmap;
 
  private:
   const uintptr_t tablesStart_;
-  // const uintptr_t tablesEnd_;
-  const PhysicalMemoryAllocator& pallocator_;
+  const uintptr_t tablesEnd_;
+  const uintptr_t kernelStart_;
+  const uintptr_t scratchStart_;
+  // Page tables are allocated from whatever allocator the kernel currently
+  // exposes, so tables created while the final allocator is still being
+  // initialized come from the bootstrap allocator.
+  const KernelContext& kernel_;
   // const VirtualMemoryAllocator& vallocator_;
   constexpr uintptr_t entryAddr(uintptr_t address) const {
     return (tablesStart_ |
@@ -375,15 +494,44 @@ class RecursivePageTables final : public PageTables {
     return tablesStart_ | (vaddr >> (9 * (int)level)) |
            ((0x7FFFFFF000 << (9 * (4 - (int)level))) & 0x7FFFFFF000);
   }
+  // Entry that maps virtAddr and the level it sits at; the first
+  // non-present entry on the way down if nothing maps it
+  struct Leaf {
+    volatile PageEntry* entry;
+    PageLevel level;
+  };
+
+  // Table at `level` covering virtAddr, creating any missing tables above it
+  rtk::StatusOr<volatile PageTable*> walk(uintptr_t virtAddr,
+                                          PageLevel level) const;
+  Leaf find(uintptr_t virtAddr) const;
+  // Kernel mappings are global, except the per-address-space table window
+  PageAttr withDefaults(uintptr_t virtAddr, PageAttr attributes) const {
+    if (Features().globalPages && virtAddr >= kernelStart_ &&
+        (virtAddr < tablesStart_ || virtAddr > tablesEnd_)) {
+      attributes |= PageAttr::Global;
+    }
+    return attributes;
+  }
+  // Walks down once and fills the rest of the leaf table in one pass
+  rtk::StatusOr<size_t> mapLeaves(size_t count, uintptr_t virtAddr,
+                                  uintptr_t physAddr,
+                                  PageAttr attributes) const override;
+  // Replaces the large page at `level` with a table of pages one level down
+  rtk::StatusCode split(uintptr_t virtAddr, PageLevel level,
+                        volatile PageEntry& entry) const;
+  // Frees the tables above a just-cleared entry at `level` if they're empty
+  void releaseEmptyTables(uintptr_t virtAddr, PageLevel level) const;
   void mapNoTables(uintptr_t virtAddr, uintptr_t physAddr,
                    PageAttr attributes) const {
     // Assumes PT for entry already exists
     // Uses recursive virtual entry address.
-    *(PageEntry*)entryAddr(virtAddr) = PageEntry(physAddr, attributes);
-    invalidate_page(virtAddr);
-  }
-  void unMapNoInvalidate(uintptr_t virtAddr) {
-    *(PageEntry*)entryAddr(virtAddr) = {};
+    auto entry = (PageEntry*)entryAddr(virtAddr);
+    const auto wasPresent = entry->present();
+    *entry = PageEntry(physAddr, attributes);
+    // Non-present entries are never cached, so there's nothing to flush
+    if (wasPresent)
+      invalidate_page(virtAddr);
   }
 };  // class RecursivePageTables
 
@@ -398,7 +546,30 @@ class PhysicalMemoryAllocator
 
   virtual rtk::StatusOr<uintptr_t> allocatePage() const = 0;
   virtual rtk::StatusOr<PageSet> allocatePages(size_t count) const = 0;
+  virtual rtk::StatusCode freePages(PageSet pages) const = 0;
+  rtk::StatusCode freePage(uintptr_t address) const {
+    return freePages({kPageSize, address, 1});
+  }
+  // Exactly `count` physically contiguous pages starting at a multiple of
+  // `alignment` (a power of two, at least kPageSize), or an error. Unlike
+  // allocatePages, never hands back a shorter run.
+  virtual rtk::StatusOr<PageSet> allocateContiguous(
+      size_t count, size_t alignment = kPageSize) const = 0;
+  // `count` naturally aligned frames of `pageSize` bytes (kPageSize,
+  // kLargePageSize or kHugePageSize) as one run; pageSize is carried in the
+  // result so freePages() gives back the whole thing.
+  rtk::StatusOr<PageSet> allocateFrames(size_t pageSize, size_t count) const {
+    if (pageSize < kPageSize || pageSize % kPageSize != 0 ||
+        count > SIZE_MAX / (pageSize / kPageSize))
+      return rtk::StatusCode::OutOfRange;
+    return allocateContiguous(count * (pageSize / kPageSize), pageSize)
+        .map([=](auto pages) {
+          return PageSet{pageSize, pages.address, count};
+        });
+  }
   virtual size_t memorySize() const = 0;
+  // Allocation statistics, for allocators that keep them
+  virtual const AllocationProfiler* profiler() const { return nullptr; }
   virtual ~PhysicalMemoryAllocator() = default;
 
  protected:
@@ -410,23 +581,143 @@ class DefaultPhysicalMemoryAllocator final : public PhysicalMemoryAllocator {
   DefaultPhysicalMemoryAllocator(MemoryBootstrapper& memoryBootstrapper);
   rtk::StatusOr<uintptr_t> allocatePage() const override;
   rtk::StatusOr<PageSet> allocatePages(size_t count) const override;
+  rtk::StatusCode freePages(PageSet pages) const override;
+  rtk::StatusOr<PageSet> allocateContiguous(size_t count,
+                                            size_t alignment) const override;
   void init(const KernelContext* kernel,
             MemoryBootstrapper& memoryBootstrapper) const;
   size_t memorySize() const override { return memorySize_; }
   rtk::StatusCode initializationStatus() { return initializationStatus_; }
 
  private:
+  static constexpr size_t kNoPage = SIZE_MAX;
+
   const size_t memorySize_;
   mutable size_t bitmapSize_;
-  mutable uint8_t* bitmap_;
+  // One bit per page frame, set when the frame is in use
+  mutable uint64_t* bitmap_;
+  // Bit n is set when bitmap_ word n has at least one free page
+  mutable uint64_t* summary1_;
+  // Bit n is set when summary1_ word n has any bit set
+  mutable uint64_t* summary2_;
+  mutable size_t bitmapWords_;
+  mutable size_t summary1Words_;
+  mutable size_t summary2Words_;
   mutable size_t lowestFreePage_;
   mutable rtk::StatusCode initializationStatus_ =
       rtk::StatusCode::Uninitialized;
-  template <typename T>
-  bool alignedFreeCheckAdvanceAndMark(size_t& pageNo, size_t count,
-                                      size_t* pagesAllocated) const;
+  size_t findFree(size_t fromPage) const;
+  size_t freeRunEnd(size_t startPage, size_t limit) const;
+  void markUsed(size_t startPage, size_t endPage) const;
+  void markFree(size_t startPage, size_t endPage) const;
+  void updateSummary(size_t word) const;
 };  // class PhysicalMemoryAllocator
 
+// Binary buddy allocator over physical page frames.
+// Free blocks of 2^order pages are kept on per-order free lists; freeing a
+// block merges it with its buddy for as long as the buddy is also free.
+// Frame metadata lives in a virtually contiguous array mapped in at init(),
+// so the allocator never touches the (unmapped) free frames themselves.
+class BuddyPhysicalMemoryAllocator final : public PhysicalMemoryAllocator {
+ public:
+  // 2^18 pages: blocks up to 1 GiB
+  static constexpr int kMaxOrder = 18;
+
+  BuddyPhysicalMemoryAllocator(MemoryBootstrapper& memoryBootstrapper);
+  rtk::StatusOr<uintptr_t> allocatePage() const override;
+  rtk::StatusOr<PageSet> allocatePages(size_t count) const override;
+  rtk::StatusCode freePages(PageSet pages) const override;
+  // Served from a single block, so at most 2^kMaxOrder pages
+  rtk::StatusOr<PageSet> allocateContiguous(size_t count,
+                                            size_t alignment) const override;
+  void init(const KernelContext* kernel,
+            MemoryBootstrapper& memoryBootstrapper) const;
+  size_t memorySize() const override { return memorySize_; }
+  size_t freePageCount() const { return freePageCount_; }
+  rtk::StatusCode initializationStatus() { return initializationStatus_; }
+
+ private:
+  enum class FrameState : uint8_t { Reserved = 0, Allocated, Free };
+  // Only the first frame of a block carries meaningful links and order;
+  // every frame carries its state.
+  struct Frame {
+    uint32_t next;
+    uint32_t prev;
+    uint8_t order;
+    FrameState state;
+  };
+  static constexpr uint32_t kNoFrame = UINT32_MAX;
+
+  const size_t memorySize_;
+  const size_t frameCount_;
+  mutable Frame* frames_;
+  mutable uint32_t freeLists_[kMaxOrder + 1];
+  mutable size_t freePageCount_;
+  mutable rtk::StatusCode initializationStatus_ =
+      rtk::StatusCode::Uninitialized;
+  void pushFree(uint32_t frame, int order) const;
+  void removeFree(uint32_t frame) const;
+  void setState(size_t frame, size_t count, FrameState state) const;
+  uint32_t popFree(int order) const;
+  uint32_t allocateBlock(int order) const;
+  void freeBlock(uint32_t frame, int order) const;
+  void freeRange(size_t frame, size_t count) const;
+};  // class BuddyPhysicalMemoryAllocator
+
+// Physical allocator backing DefaultKernelContext.
+// Build with -DKERNEL_BITMAP_PAGE_ALLOCATOR to use the bitmap allocator.
+#ifdef KERNEL_BITMAP_PAGE_ALLOCATOR
+using KernelPhysicalMemoryAllocator = DefaultPhysicalMemoryAllocator;
+#else
+using KernelPhysicalMemoryAllocator = BuddyPhysicalMemoryAllocator;
+#endif
+
+// Per-CPU magazines of free frames in front of a shared allocator.
+// Single pages come from and go to the local CPU's magazine with only
+// interrupts disabled; the backing allocator is locked and only sees batches
+// of kBatchSize frames when a magazine runs empty or fills up. Multi-page
+// requests go straight to the backing allocator.
+// Every kernel frame request passes through here, so this is where frame
+// allocations are profiled, classed by order (log2 of the page count).
+class PerCpuPageCache final : public PhysicalMemoryAllocator {
+ public:
+  static constexpr size_t kMagazineSize = 64;
+  static constexpr size_t kBatchSize = kMagazineSize / 2;
+
+  PerCpuPageCache(const PhysicalMemoryAllocator& backing, size_t cpuCount);
+  rtk::StatusOr<uintptr_t> allocatePage() const override;
+  rtk::StatusOr<PageSet> allocatePages(size_t count) const override;
+  rtk::StatusCode freePages(PageSet pages) const override;
+  rtk::StatusOr<PageSet> allocateContiguous(size_t count,
+                                            size_t alignment) const override;
+  size_t memorySize() const override { return backing_.memorySize(); }
+  const AllocationProfiler* profiler() const override { return &profiler_; }
+
+ private:
+  // Cache line aligned so CPUs never share one
+  struct alignas(64) Magazine {
+    size_t count;
+    uintptr_t frames[kMagazineSize];
+  };
+
+  const PhysicalMemoryAllocator& backing_;
+  const size_t cpuCount_;
+  mutable SpinLock lock_;
+  mutable Magazine magazines_[kMaxCpus];
+  const AllocationProfiler profiler_{"page frames",
+                                     AllocationProfiler::kMaxClasses};
+
+  // nullptr when the current CPU has no magazine; call with interrupts off
+  Magazine* localMagazine() const;
+  rtk::StatusOr<uintptr_t> takePage() const;
+  void record(const rtk::StatusOr<PageSet>& result, const void* site) const;
+  void refill(Magazine& magazine) const;
+  void drain(Magazine& magazine) const;
+};  // class PerCpuPageCache
+
+// Kernel address space regions handed out by VirtualMemoryAllocator
+enum class VirtualRegion : int { Heap = 0, MemoryMaps = 1 };
+
 class VirtualMemoryAllocator {
  public:
   VirtualMemoryAllocator(const VirtualMemoryAllocator& other) = delete;
@@ -437,16 +728,152 @@ class VirtualMemoryAllocator {
 
   virtual rtk::StatusOr<uintptr_t> allocatePage() const = 0;
   virtual rtk::StatusOr<PageSet> allocatePages(size_t count) const = 0;
+  // `count` pages in `region`, with `guardPages` pages on either side that
+  // are never handed out, so never mapped
+  virtual rtk::StatusOr<PageSet> allocatePages(size_t count,
+                                               VirtualRegion region,
+                                               size_t guardPages) const = 0;
+  // Takes back a range exactly as allocatePages returned it
+  virtual rtk::StatusCode freePages(PageSet pages) const = 0;
+  // Whether `address` lies in a range allocatePages handed out, guard pages
+  // excluded
+  virtual bool contains(uintptr_t address) const = 0;
 
  protected:
   VirtualMemoryAllocator() = default;
 };  // class VirtualMemoryAllocator
 
+// Best-fit allocator for kernel virtual address space.
+// Each region keeps its free segments in two AVL trees, by address for
+// coalescing and by size for best fit, and its allocated segments in a third
+// so frees can be checked and their guard pages found again. Segment records
+// live in pages the allocator maps for itself, never on the heap.
 class DefaultVirtualMemoryAllocator final : public VirtualMemoryAllocator {
  public:
+  DefaultVirtualMemoryAllocator() = default;
   rtk::StatusOr<uintptr_t> allocatePage() const override;
   rtk::StatusOr<PageSet> allocatePages(size_t count) const override;
-};  // class VirtualMemoryAllocator
+  rtk::StatusOr<PageSet> allocatePages(size_t count, VirtualRegion region,
+                                       size_t guardPages) const override;
+  rtk::StatusCode freePages(PageSet pages) const override;
+  bool contains(uintptr_t address) const override;
+  // Takes over the heap and whatever part of the memory maps region the
+  // bootstrapper hasn't handed out yet
+  void init(const KernelContext* kernel,
+            MemoryBootstrapper& memoryBootstrapper) const;
+  rtk::StatusCode initializationStatus() { return initializationStatus_; }
+
+ private:
+  struct Segment;
+  struct Link {
+    Segment* left;
+    Segment* right;
+    int height;
+  };
+  struct Segment {
+    uintptr_t start;  // guard pages included
+    size_t pages;
+    size_t guardPages;
+    Link byAddress;  // also links spare records
+    Link bySize;
+
+    uintptr_t end() const { return start + pages * kPageSize; }
+  };
+  struct Region {
+    uintptr_t start;
+    uintptr_t end;  // exclusive
+    Segment* freeByAddress;
+    Segment* freeBySize;
+    Segment* allocated;
+  };
+  struct ByAddress;
+  struct BySize;
+  template <typename Order>
+  class Tree;
+
+  // Enough records for one allocation plus mapping another record page
+  static constexpr size_t kSpareSegments = 4;
+  static constexpr int kRegionCount = 2;
+
+  mutable const KernelContext* kernel_ = nullptr;
+  mutable SpinLock lock_;
+  mutable Region regions_[kRegionCount] = {};
+  mutable Segment* spares_ = nullptr;
+  mutable size_t spareCount_ = 0;
+  mutable rtk::StatusCode initializationStatus_ =
+      rtk::StatusCode::Uninitialized;
+
+  Region* regionFor(uintptr_t address) const;
+  rtk::StatusCode mapSegmentPage(uintptr_t page) const;
+  Segment* takeSpare() const;
+  void releaseSpare(Segment* segment) const;
+  void refillSpares() const;
+  void addFree(Region& region, uintptr_t start, size_t pages) const;
+  rtk::StatusOr<PageSet> allocateIn(Region& region, size_t count,
+                                    size_t guardPages) const;
+  rtk::StatusCode freeIn(Region& region, PageSet pages) const;
+};  // class DefaultVirtualMemoryAllocator
+
+// Frames zeroed ahead of time, so page faults don't pay for the zeroing.
+// Frames are zeroed through a scratch page mapped to each in turn. Each CPU
+// remaps it before writing, which drops its own stale translation, so no
+// other CPU's TLB needs flushing.
+class ZeroedPagePool final {
+ public:
+  static constexpr size_t kCapacity = 256;
+  // Frames zeroed per idle() call, to keep the CPU responsive
+  static constexpr size_t kFillBatch = 16;
+
+  ZeroedPagePool(const KernelContext& kernel) : kernel_{kernel} {}
+  // Reserves the scratch page
+  void init() const;
+  // A zeroed frame, from the pool when it has one or zeroed on the spot
+  rtk::StatusOr<uintptr_t> allocatePage() const;
+  // Takes back a frame that's still all zeroes
+  void freePage(uintptr_t frame) const;
+  // Zeroes up to `count` frames into the pool. False once the pool is full
+  // or there are no frames left to zero.
+  bool fill(size_t count) const;
+
+ private:
+  const KernelContext& kernel_;
+  mutable SpinLock lock_;
+  mutable uintptr_t frames_[kCapacity];
+  mutable size_t count_ = 0;
+  mutable uintptr_t scratch_ = 0;
+  mutable rtk::StatusCode initializationStatus_ =
+      rtk::StatusCode::Uninitialized;
+
+  // Call with lock_ held
+  rtk::StatusCode zero(uintptr_t frame) const;
+};  // class ZeroedPagePool
+
+// Kernel heap backed on demand. Reserving heap address space maps nothing;
+// the first touch of each reserved page faults in a zeroed frame, so large
+// reservations cost only their address space until they're used.
+class DemandPagedHeap final {
+ public:
+  DemandPagedHeap(const KernelContext& kernel)
+      : kernel_{kernel}, zeroedPages_{kernel} {}
+  void init() const { zeroedPages_.init(); }
+
+  // `count` pages of heap address space between two guard pages
+  rtk::StatusOr<PageSet> reserve(size_t count) const;
+  // Unmaps whatever was touched and gives back the frames and address space
+  rtk::StatusCode release(PageSet pages) const;
+  // Ok if the fault was the first touch of a reserved heap page, which is
+  // now mapped. Called with interrupts disabled.
+  rtk::StatusCode handleFault(uintptr_t address, uint64_t errorCode) const;
+  // Background work for a CPU with nothing better to do; false once there's
+  // none left
+  bool idle() const { return zeroedPages_.fill(ZeroedPagePool::kFillBatch); }
+
+ private:
+  const KernelContext& kernel_;
+  const ZeroedPagePool zeroedPages_;
+  // Serializes faults so each page is backed exactly once
+  mutable SpinLock lock_;
+};  // class DemandPagedHeap
 
 class MemoryBootstrapper : public rtk::DynamicPlacement<MemoryBootstrapper> {
  public:
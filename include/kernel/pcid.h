@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "kernel/cpu.h"
+
+namespace k {
+// What an address space remembers about the PCID it last ran with on each
+// CPU: that CPU's generation above the low 12 bits and the PCID in them, or
+// 0 if it has none there
+struct AddressSpaceTag {
+  uint64_t ids[kMaxCpus] = {};
+};
+
+// Hands out PCIDs, the 12-bit tags the TLB keeps per address space, so that
+// switching CR3 doesn't throw the outgoing translations away. Each CPU hands
+// out its own, since a flush only reaches the TLB of the CPU doing it. IDs
+// are handed out in order; once a CPU runs out its TLB is flushed and a new
+// generation starts there, and address spaces from an older generation get
+// a fresh ID the next time they're switched to on it. PCID 0 stays with the
+// boot page tables, and CPUs past kMaxCpus use nothing else.
+class PcidAllocator final {
+ public:
+  static constexpr uint16_t kPcidCount = 4096;
+
+  PcidAllocator() = default;
+  PcidAllocator(const PcidAllocator& other) = delete;
+  PcidAllocator& operator=(const PcidAllocator& other) = delete;
+
+  // CR3 value that switches to the tables at pml4Paddr. Keeps the TLB
+  // contents for `tag` when they are still ours; updates `tag` otherwise.
+  uint64_t cr3For(uintptr_t pml4Paddr, AddressSpaceTag& tag) const;
+  void switchTo(uintptr_t pml4Paddr, AddressSpaceTag& tag) const;
+  // Forgets an address space that is going away, dropping its translations
+  // on this CPU. Other CPUs flush its IDs when they hand them out again.
+  void release(AddressSpaceTag& tag) const;
+
+ private:
+  // Only touched by its own CPU, with interrupts off
+  struct CpuPcids {
+    uint16_t next = 1;
+    uint64_t generation = 1;
+  };
+
+  mutable CpuPcids cpus_[kMaxCpus];
+};  // class PcidAllocator
+}  // namespace k
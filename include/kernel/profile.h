@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/logging.h"
+#include "kernel/sync.h"
+
+namespace k {
+// Sampled allocation statistics for one allocator, by size class and by call
+// site (return address). Off until setSampling(); then every Nth allocation
+// is recorded and tracked until it's freed, so the cost stays bounded by N.
+// Counts are of sampled allocations; dump() scales them back up by N.
+// Uses fixed tables only, so it never allocates. Allocations that find the
+// tables full are counted as dropped instead.
+class AllocationProfiler final {
+ public:
+  static constexpr int kMaxClasses = 32;
+  static constexpr size_t kMaxSites = 128;
+  static constexpr size_t kMaxTracked = 512;
+  // Sites dump() lists, by live bytes
+  static constexpr size_t kDumpSites = 16;
+
+  struct Stats {
+    size_t allocations;
+    size_t bytes;  // ever allocated
+    size_t live;
+    size_t liveBytes;
+    size_t peakBytes;  // most live bytes at once
+  };
+  struct SiteStats {
+    const void* site;
+    Stats stats;
+  };
+
+  // `classCount` classes, at most kMaxClasses, named in dumps by `name`
+  AllocationProfiler(const char* name, int classCount)
+      : name_{name},
+        classCount_{classCount < kMaxClasses ? classCount : kMaxClasses} {}
+  AllocationProfiler(const AllocationProfiler& other) = delete;
+  AllocationProfiler& operator=(const AllocationProfiler& other) = delete;
+
+  // Records one allocation in every `every`; 0 turns profiling off.
+  // Allocations already tracked are still matched with their frees.
+  void setSampling(uint32_t every) const;
+  uint32_t sampling() const {
+    return __atomic_load_n(&every_, __ATOMIC_RELAXED);
+  }
+
+  // Call on every allocation and free; cheap unless profiling
+  void recordAllocation(const void* ptr, size_t bytes, int sizeClass,
+                        const void* site) const {
+    if (sampling() == 0 ||
+        __atomic_sub_fetch(&countdown_, 1, __ATOMIC_RELAXED) > 0)
+      return;
+    sample(ptr, bytes, sizeClass, site);
+  }
+  void recordFree(const void* ptr) const {
+    if (__atomic_load_n(&trackedCount_, __ATOMIC_RELAXED) == 0)
+      return;
+    untrack(ptr);
+  }
+
+  // Snapshots, in sampled allocations
+  Stats classStats(int sizeClass) const;
+  // Sites in no particular order; siteStats(i) for i < siteCount()
+  size_t siteCount() const;
+  SiteStats siteStats(size_t index) const;
+  size_t dropped() const;
+  // Forgets everything, including tracked allocations
+  void reset() const;
+
+  // Logs per-class stats and the sites holding the most live memory
+  void dump(const rtk::Logger& logger,
+            rtk::LogLevel level = rtk::LogLevel::Info) const;
+
+ private:
+  static constexpr uint32_t kNoSite = UINT32_MAX;
+
+  struct Tracked {
+    const void* ptr;  // nullptr: free slot
+    size_t bytes;
+    uint32_t site;
+    int32_t sizeClass;
+  };
+
+  const char* const name_;
+  const int classCount_;
+  mutable uint32_t every_ = 0;
+  mutable int64_t countdown_ = 0;
+  mutable size_t trackedCount_ = 0;
+  mutable SpinLock lock_;
+  mutable size_t dropped_ = 0;
+  mutable Stats classes_[kMaxClasses] = {};
+  mutable SiteStats sites_[kMaxSites] = {};
+  mutable size_t siteCount_ = 0;
+  mutable Tracked tracked_[kMaxTracked] = {};
+
+  // Call with the lock held
+  uint32_t findSite(const void* site) const;
+  size_t findTracked(const void* ptr) const;
+  void removeTracked(size_t slot) const;
+  static void addLive(Stats& stats, size_t bytes);
+
+  void sample(const void* ptr, size_t bytes, int sizeClass,
+              const void* site) const;
+  void untrack(const void* ptr) const;
+};  // class AllocationProfiler
+}  // namespace k
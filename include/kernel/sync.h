@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include "asm.h"
+
+namespace k {
+// Disables interrupts on the local CPU for the guard's lifetime
+class InterruptGuard final {
+ public:
+  InterruptGuard() : flags_{save_and_disable_interrupts()} {}
+  ~InterruptGuard() { restore_interrupts(flags_); }
+
+  InterruptGuard(const InterruptGuard& other) = delete;
+  InterruptGuard& operator=(const InterruptGuard& other) = delete;
+
+ private:
+  const uint64_t flags_;
+};  // class InterruptGuard
+
+// Test-and-test-and-set spin lock. Hold it with interrupts disabled if an
+// interrupt handler can take it too.
+class SpinLock final {
+ public:
+  SpinLock() = default;
+  SpinLock(const SpinLock& other) = delete;
+  SpinLock& operator=(const SpinLock& other) = delete;
+
+  void lock() {
+    while (__atomic_test_and_set(&locked_, __ATOMIC_ACQUIRE)) {
+      while (__atomic_load_n(&locked_, __ATOMIC_RELAXED)) {
+        __builtin_ia32_pause();
+      }
+    }
+  }
+  void unlock() { __atomic_clear(&locked_, __ATOMIC_RELEASE); }
+
+ private:
+  bool locked_ = false;
+};  // class SpinLock
+
+template <typename Lock>
+class LockGuard final {
+ public:
+  explicit LockGuard(Lock& lock) : lock_{lock} { lock_.lock(); }
+  ~LockGuard() { lock_.unlock(); }
+
+  LockGuard(const LockGuard& other) = delete;
+  LockGuard& operator=(const LockGuard& other) = delete;
+
+ private:
+  Lock& lock_;
+};  // class LockGuard
+}  // namespace k
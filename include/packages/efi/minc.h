@@ -11,6 +11,12 @@
 #define memcpy(a, b, c) _memcpy(a, b, c)
 #define memset(a, b, c) _memset(a, b, c)
 #define memcmp(a, b, c) _memcmp(a, b, c)
+#define memmove(a, b, c) _memmove(a, b, c)
+
+// Unaligned 8-byte accesses for the word-at-a-time loops
+typedef uint64_t _minc_word __attribute__((aligned(1), may_alias));
+// From here on rep movsb/stosb win, fast strings or not
+#define _MINC_REP_THRESHOLD 256
 
 static inline uint32_t _strtoul(const char* p) {
   uint32_t n = 0;
@@ -47,23 +53,56 @@ static inline size_t _strlen(const char* s) {
   return len;
 }
 
+// Front to back, so also right for an overlapping dest below src
 static inline void* _memcpy(void* dest, const void* src, size_t n) {
   unsigned char* d = (unsigned char*)dest;
   const unsigned char* s = (const unsigned char*)src;
+  if (n >= _MINC_REP_THRESHOLD) {
+    __asm__ volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(n) : : "memory");
+    return dest;
+  }
+  for (; n >= 8; n -= 8, d += 8, s += 8)
+    *(_minc_word*)d = *(const _minc_word*)s;
   while (n--)
     *d++ = *s++;
   return dest;
 }
 
+static inline void* _memmove(void* dest, const void* src, size_t n) {
+  unsigned char* d = (unsigned char*)dest;
+  const unsigned char* s = (const unsigned char*)src;
+  if ((uintptr_t)d - (uintptr_t)s >= n)
+    return _memcpy(dest, src, n);
+  // dest overlaps the end of src: back to front
+  for (; n >= 8; n -= 8)
+    *(_minc_word*)(d + n - 8) = *(const _minc_word*)(s + n - 8);
+  while (n--)
+    d[n] = s[n];
+  return dest;
+}
+
 static inline void _memset(void* dest, unsigned char val, size_t n) {
-  for (size_t i = 0; i < n; i++)
-    ((unsigned char*)dest)[i] = val;
+  unsigned char* d = (unsigned char*)dest;
+  if (n >= _MINC_REP_THRESHOLD) {
+    __asm__ volatile("rep stosb" : "+D"(d), "+c"(n) : "a"(val) : "memory");
+    return;
+  }
+  const uint64_t pattern = val * 0x0101010101010101ULL;
+  for (; n >= 8; n -= 8, d += 8)
+    *(_minc_word*)d = pattern;
+  while (n--)
+    *d++ = val;
 }
 
 static inline int _memcmp(const void* a, const void* b, size_t n) {
   const unsigned char *pa = (const unsigned char*)a,
                       *pb = (const unsigned char*)b;
-  for (size_t i = 0; i < n; i++) {
+  size_t i = 0;
+  // Skip equal words, then find the differing byte
+  while (i + 8 <= n &&
+         *(const _minc_word*)(pa + i) == *(const _minc_word*)(pb + i))
+    i += 8;
+  for (; i < n; i++) {
     if (pa[i] != pb[i])
       return pa[i] - pb[i];
   }
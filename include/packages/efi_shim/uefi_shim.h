@@ -23,6 +23,9 @@ class UefiBootstrapPhysicalMemoryAllocator final  // aka using UPAllocator
 
   rtk::StatusOr<uintptr_t> allocatePage() const override;
   rtk::StatusOr<k::PageSet> allocatePages(size_t count) const override;
+  rtk::StatusCode freePages(k::PageSet pages) const override;
+  rtk::StatusOr<k::PageSet> allocateContiguous(size_t count,
+                                               size_t alignment) const override;
   size_t memorySize() const override;
 
  private:
@@ -92,6 +95,7 @@ class UefiKernelBootstrapper final : public k::KernelBootstrapper {
   k::MemoryBootstrapper& memoryBootstrapper() override {
     return memoryBootstrapper_;
   }
+  size_t cpuCount() const override { return bootInfo_.cpu_count; }
   const boot_info_t& bootInfo() const { return bootInfo_; }
 
  private:
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -10,6 +11,31 @@ void halt_cpu();
 void enable_interrupts();
 void disable_interrupts();
 void invalidate_page(uintptr_t addr);
+void flush_tlb_all();
+uint64_t read_cr3();
+void write_cr3(uint64_t value);
+uint64_t read_cr4();
+void write_cr4(uint64_t value);
+void invpcid(uint64_t type, uint64_t pcid, uintptr_t addr);
+uint64_t save_and_disable_interrupts();
+void restore_interrupts(uint64_t flags);
+uint64_t read_msr(uint32_t msr);
+void write_msr(uint32_t msr, uint64_t value);
+uint32_t current_cpu_index();
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]);
+void load_idt(const void* base, uint16_t limit);
+uint16_t read_cs();
+void copy_bytes(void* dest, const void* src, size_t n);
+void fill_bytes(void* dest, uint8_t val, size_t n);
+void fill_nontemporal(void* dest, uint64_t pattern, size_t n);
+void zero_pages_stosq(void* dest, size_t n);
+void copy_pages_movsq(void* dest, const void* src, size_t n);
+void copy_pages_nontemporal(void* dest, const void* src, size_t n);
+uint64_t read_tsc();
+
+// Interrupt gate targets, not to be called
+void page_fault_entry();
+void halt_on_trap();
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -7,4 +7,12 @@ static inline void freeze() {
   disable_interrupts();
   while (true)
     halt_cpu();
+}
+
+// Where a CPU goes when it has nothing left to run: background work until
+// there's none left, then freeze()
+static inline void idle() {
+  while (k::Context().heap().idle()) {
+  }
+  freeze();
 }
\ No newline at end of file
@@ -0,0 +1,305 @@
+#include "core/stdlib/freestanding/stdint.h"
+#include "kernel.h"
+
+using namespace k;
+
+#define CHECK_INIT_STATUS()                           \
+  do {                                                \
+    if (initializationStatus_ != rtk::StatusCode::Ok) \
+      return rtk::StatusCode::InitializationError;    \
+  } while (0)
+
+// Smallest order whose block holds at least `count` pages
+static inline int orderForCount(size_t count) {
+  if (count <= 1)
+    return 0;
+  return UINT64_WIDTH - __builtin_clzll(count - 1);
+}
+
+// Largest order whose block fits in `count` pages
+static inline int orderFloor(size_t count) {
+  return UINT64_WIDTH - 1 - __builtin_clzll(count);
+}
+
+BuddyPhysicalMemoryAllocator::BuddyPhysicalMemoryAllocator(
+    MemoryBootstrapper& memoryBootstrapper)
+    : memorySize_(memoryBootstrapper.memorySize()),
+      frameCount_(memoryBootstrapper.memorySize() / kPageSize),
+      frames_(nullptr),
+      freePageCount_(0) {
+  for (auto& head : freeLists_) {
+    head = kNoFrame;
+  }
+}
+
+void BuddyPhysicalMemoryAllocator::init(
+    const KernelContext* kernel, MemoryBootstrapper& bootstrapper) const {
+  auto& status = initializationStatus_;  // alias
+
+  // Index addressing is 32 bits wide (16 TiB of 4 KiB frames)
+  if (frameCount_ >= kNoFrame) {
+    status = rtk::StatusCode::OutOfRange;
+    return;
+  }
+
+  // One metadata record per frame, rounded up to whole pages
+  const auto metadataBytes = frameCount_ * sizeof(Frame);
+  auto pagesNeeded = (metadataBytes + kPageSize - 1) / kPageSize;
+
+  // Reserve our virtual memory space
+  auto memResult = bootstrapper.reserveVirtualMemory(pagesNeeded);
+  if (!memResult)  // out of mem?
+    return;
+
+  const auto metadataStart = memResult.get();
+  frames_ = reinterpret_cast<Frame*>(metadataStart);
+
+  auto currentPage = metadataStart;
+
+  // Back the metadata array with physical pages from the bootstrap allocator
+  while (pagesNeeded > 0) {
+    auto memResult = kernel->pageAllocator().allocatePages(pagesNeeded);
+    if (!memResult.ok())
+      return;  // out of physical mem?
+    auto newPages = memResult.get();
+
+    const auto bytesAllocated = newPages.count * kPageSize;
+
+    status =
+        kernel->pageTables().map(newPages.count, currentPage, newPages.address,
+                                 PageAttr::Present | PageAttr::RW);
+    if (status != rtk::StatusCode::Ok)  // out of mem creating tables?
+      return;
+
+    // Every frame starts out reserved until the memory map says otherwise
+    ZeroPages(PageSet{kPageSize, currentPage, newPages.count});
+
+    currentPage += bytesAllocated;
+    pagesNeeded -= newPages.count;
+  }
+
+  // Seed the free lists from the remaining free physical memory
+  for (auto range : bootstrapper.processFreePhysicalMemoryPages()) {
+    auto startFrame = range.address / kPageSize;
+    auto count = range.count * (range.pageSize / kPageSize);
+    if (startFrame >= frameCount_)
+      continue;
+    if (startFrame + count > frameCount_) {
+      count = frameCount_ - startFrame;
+    }
+    freeRange(startFrame, count);
+  }
+
+  status = rtk::StatusCode::Ok;
+}
+
+void BuddyPhysicalMemoryAllocator::pushFree(uint32_t frame, int order) const {
+  auto& f = frames_[frame];
+  auto& head = freeLists_[order];
+  f.order = order;
+  f.state = FrameState::Free;
+  f.prev = kNoFrame;
+  f.next = head;
+  if (head != kNoFrame) {
+    frames_[head].prev = frame;
+  }
+  head = frame;
+  freePageCount_ += 1ULL << order;
+}
+
+void BuddyPhysicalMemoryAllocator::removeFree(uint32_t frame) const {
+  auto& f = frames_[frame];
+  if (f.prev != kNoFrame) {
+    frames_[f.prev].next = f.next;
+  } else {
+    freeLists_[f.order] = f.next;
+  }
+  if (f.next != kNoFrame) {
+    frames_[f.next].prev = f.prev;
+  }
+  freePageCount_ -= 1ULL << f.order;
+}
+
+void BuddyPhysicalMemoryAllocator::setState(size_t frame, size_t count,
+                                            FrameState state) const {
+  for (auto end = frame + count; frame < end; frame++) {
+    frames_[frame].state = state;
+  }
+}
+
+uint32_t BuddyPhysicalMemoryAllocator::popFree(int order) const {
+  auto frame = freeLists_[order];
+  if (frame != kNoFrame) {
+    removeFree(frame);
+  }
+  return frame;
+}
+
+void BuddyPhysicalMemoryAllocator::freeBlock(uint32_t frame, int order) const {
+  // Per block, not per range: a buddy later in the range isn't a free
+  // block yet, so it mustn't look like one
+  setState(frame, 1ULL << order, FrameState::Free);
+
+  // Merge upwards while our buddy is a free block of the same order
+  while (order < kMaxOrder) {
+    const auto buddy = frame ^ (1U << order);
+    if (buddy + (1ULL << order) > frameCount_)
+      break;
+    const auto& b = frames_[buddy];
+    if (b.state != FrameState::Free || b.order != order)
+      break;
+    removeFree(buddy);
+    frame &= ~(1U << order);  // merged block starts at the lower buddy
+    order++;
+  }
+  pushFree(frame, order);
+}
+
+void BuddyPhysicalMemoryAllocator::freeRange(size_t frame, size_t count) const {
+  // Carve the range into the largest naturally aligned blocks
+  while (count > 0) {
+    auto order = orderFloor(count);
+    if (frame != 0) {
+      const auto alignOrder = __builtin_ctzll(frame);
+      if (alignOrder < order)
+        order = alignOrder;
+    }
+    if (order > kMaxOrder)
+      order = kMaxOrder;
+    freeBlock(static_cast<uint32_t>(frame), order);
+    frame += 1ULL << order;
+    count -= 1ULL << order;
+  }
+}
+
+// Takes a block of exactly `order`, splitting a larger one if need be
+uint32_t BuddyPhysicalMemoryAllocator::allocateBlock(int order) const {
+  // Smallest block that satisfies the request
+  auto found = order;
+  while (found <= kMaxOrder && freeLists_[found] == kNoFrame) {
+    found++;
+  }
+  if (found > kMaxOrder)
+    return kNoFrame;
+
+  const auto frame = popFree(found);
+
+  // Split down to the requested order, freeing the upper halves
+  while (found > order) {
+    found--;
+    pushFree(frame + (1U << found), found);
+  }
+  return frame;
+}
+
+rtk::StatusOr<uintptr_t> BuddyPhysicalMemoryAllocator::allocatePage() const {
+  CHECK_INIT_STATUS();
+
+  // Order 0 fast path: no splitting bookkeeping beyond the free list pop
+  auto frame = popFree(0);
+  if (frame != kNoFrame) {
+    frames_[frame].state = FrameState::Allocated;
+    return static_cast<uintptr_t>(frame) * kPageSize;
+  }
+  return allocatePages(1).map([](auto pageSet) { return pageSet.address; });
+}
+
+rtk::StatusOr<PageSet> BuddyPhysicalMemoryAllocator::allocatePages(
+    size_t count) const {
+  CHECK_INIT_STATUS();
+
+  if (count == 0) {
+    return rtk::StatusCode::OutOfRange;
+  }
+
+  auto wanted = orderForCount(count);
+  if (wanted > kMaxOrder) {
+    wanted = kMaxOrder;
+    count = 1ULL << kMaxOrder;
+  }
+
+  auto frame = allocateBlock(wanted);
+
+  // Nothing big enough: like the other allocators, hand back the largest
+  // run we have and let the caller ask again for the rest.
+  if (frame == kNoFrame) {
+    auto order = wanted - 1;
+    while (order >= 0 && freeLists_[order] == kNoFrame) {
+      order--;
+    }
+    if (order < 0) {
+      return rtk::StatusCode::OutOfMemory;
+    }
+    frame = popFree(order);
+    wanted = order;
+    count = 1ULL << order;
+  }
+
+  // Give back the unused tail of a non-power-of-two request
+  const auto blockPages = 1ULL << wanted;
+  if (count < blockPages) {
+    freeRange(frame + count, blockPages - count);
+  }
+  setState(frame, count, FrameState::Allocated);
+
+  return PageSet{kPageSize, static_cast<uintptr_t>(frame) * kPageSize, count};
+}
+
+rtk::StatusOr<PageSet> BuddyPhysicalMemoryAllocator::allocateContiguous(
+    size_t count, size_t alignment) const {
+  CHECK_INIT_STATUS();
+
+  if (count == 0 || alignment < kPageSize ||
+      (alignment & (alignment - 1)) != 0) {
+    return rtk::StatusCode::OutOfRange;
+  }
+
+  // Blocks are naturally aligned, so alignment is just a minimum order
+  auto order = orderForCount(count);
+  const auto alignOrder = __builtin_ctzll(alignment / kPageSize);
+  if (alignOrder > order) {
+    order = alignOrder;
+  }
+  if (order > kMaxOrder) {
+    return rtk::StatusCode::OutOfRange;
+  }
+
+  const auto frame = allocateBlock(order);
+  if (frame == kNoFrame) {
+    return rtk::StatusCode::OutOfMemory;
+  }
+
+  // Give back the unused tail
+  const auto blockPages = 1ULL << order;
+  if (count < blockPages) {
+    freeRange(frame + count, blockPages - count);
+  }
+  setState(frame, count, FrameState::Allocated);
+
+  return PageSet{kPageSize, static_cast<uintptr_t>(frame) * kPageSize, count};
+}
+
+rtk::StatusCode BuddyPhysicalMemoryAllocator::freePages(PageSet pages) const {
+  CHECK_INIT_STATUS();
+
+  if (pages.pageSize < kPageSize ||
+      pages.count > SIZE_MAX / (pages.pageSize / kPageSize)) {
+    return rtk::StatusCode::OutOfRange;
+  }
+  const auto frame = pages.address / kPageSize;
+  const auto count = pages.count * (pages.pageSize / kPageSize);
+  if (count == 0 || pages.address % kPageSize != 0 ||
+      count > frameCount_ || frame > frameCount_ - count) {
+    return rtk::StatusCode::OutOfRange;
+  }
+
+  // Only frames we handed out can come back: not reserved ones, and not
+  // ones already free (double free), even inside a larger free block
+  for (auto f = frame; f < frame + count; f++) {
+    if (frames_[f].state != FrameState::Allocated)
+      return rtk::StatusCode::OutOfRange;
+  }
+
+  freeRange(frame, count);
+  return rtk::StatusCode::Ok;
+}
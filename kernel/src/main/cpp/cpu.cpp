@@ -0,0 +1,109 @@
+#include "kernel/cpu.h"
+
+using namespace k;
+
+// The last block is shared by every CPU past kMaxCpus
+static CpuLocal cpuLocals[kMaxCpus + 1];
+
+static CpuFeatures features;
+
+enum CpuidRegister { kEax = 0, kEbx, kEcx, kEdx };
+constexpr uint32_t kCpuidMax = 0x00000000;
+constexpr uint32_t kCpuidFeatures = 0x00000001;
+constexpr uint32_t kCpuidPcidBit = 1U << 17;  // ecx
+constexpr uint32_t kCpuidPgeBit = 1U << 13;   // edx
+constexpr uint32_t kCpuidExtendedFeaturesLeaf7 = 0x00000007;
+constexpr uint32_t kCpuidInvpcidBit = 1U << 10;  // ebx
+constexpr uint32_t kCpuidErmsBit = 1U << 9;      // ebx
+constexpr uint32_t kCpuidExtendedMax = 0x80000000;
+constexpr uint32_t kCpuidExtendedFeatures = 0x80000001;
+constexpr uint32_t kCpuidPdpe1gbBit = 1U << 26;  // edx
+// Deterministic cache parameters: Intel's leaf, and AMD's copy of it
+constexpr uint32_t kCpuidCacheParameters = 0x00000004;
+constexpr uint32_t kCpuidExtendedCacheParameters = 0x8000001D;
+
+constexpr uint64_t kCr4Pge = 1ULL << 7;
+constexpr uint64_t kCr4Pcide = 1ULL << 17;
+constexpr uint64_t kCr3PcidMask = 0xFFF;
+
+// Size of the outermost cache `leaf` describes, or 0 if it describes none
+static size_t LastLevelCacheBytes(uint32_t leaf) {
+  uint32_t regs[4];
+  size_t bytes = 0;
+  uint32_t deepest = 0;
+  // A handful of caches at most; stop at the first empty entry
+  for (uint32_t index = 0; index < 16; index++) {
+    cpuid(leaf, index, regs);
+    const auto type = regs[kEax] & 0x1F;
+    if (type == 0)
+      break;
+    const auto level = (regs[kEax] >> 5) & 0x7;
+    // Data and unified caches only
+    if (type != 2 && level >= deepest) {
+      const size_t ways = (regs[kEbx] >> 22) + 1;
+      const size_t partitions = ((regs[kEbx] >> 12) & 0x3FF) + 1;
+      const size_t line = (regs[kEbx] & 0xFFF) + 1;
+      const size_t sets = size_t{regs[kEcx]} + 1;
+      deepest = level;
+      bytes = ways * partitions * line * sets;
+    }
+  }
+  return bytes;
+}
+
+void k::DetectCpuFeatures() {
+  uint32_t regs[4];
+
+  cpuid(kCpuidMax, 0, regs);
+  const auto maxLeaf = regs[kEax];
+  cpuid(kCpuidFeatures, 0, regs);
+  features.globalPages = regs[kEdx] & kCpuidPgeBit;
+  features.pcid = regs[kEcx] & kCpuidPcidBit;
+  if (maxLeaf >= kCpuidExtendedFeaturesLeaf7) {
+    cpuid(kCpuidExtendedFeaturesLeaf7, 0, regs);
+    features.invpcid = regs[kEbx] & kCpuidInvpcidBit;
+    features.erms = regs[kEbx] & kCpuidErmsBit;
+  }
+  if (maxLeaf >= kCpuidCacheParameters) {
+    features.lastLevelCache = LastLevelCacheBytes(kCpuidCacheParameters);
+  }
+
+  cpuid(kCpuidExtendedMax, 0, regs);
+  const auto maxExtendedLeaf = regs[kEax];
+  if (maxExtendedLeaf >= kCpuidExtendedFeatures) {
+    cpuid(kCpuidExtendedFeatures, 0, regs);
+    features.hugePages = regs[kEdx] & kCpuidPdpe1gbBit;
+  }
+  if (features.lastLevelCache == 0 &&
+      maxExtendedLeaf >= kCpuidExtendedCacheParameters) {
+    features.lastLevelCache =
+        LastLevelCacheBytes(kCpuidExtendedCacheParameters);
+  }
+}
+
+const CpuFeatures& k::Features() {
+  return features;
+}
+
+void k::InitCpuPaging() {
+  auto cr4 = read_cr4();
+  if (features.globalPages) {
+    cr4 |= kCr4Pge;
+  }
+  if (features.pcid && !(cr4 & kCr4Pcide)) {
+    // PCIDE can only be turned on while running with PCID 0
+    write_cr3(read_cr3() & ~kCr3PcidMask);
+    cr4 |= kCr4Pcide;
+  }
+  write_cr4(cr4);
+}
+
+void k::InitCpuLocal(uint32_t index) {
+  if (index > kMaxCpus) {
+    index = kMaxCpus;
+  }
+  auto& local = cpuLocals[index];
+  local.self = &local;
+  local.index = index;
+  write_msr(kMsrGsBase, reinterpret_cast<uint64_t>(&local));
+}
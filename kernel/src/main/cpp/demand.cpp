@@ -0,0 +1,171 @@
+#include "kernel.h"
+#include "kernel/interrupts.h"
+
+using namespace k;
+
+#define CHECK_INIT_STATUS()                           \
+  do {                                                \
+    if (initializationStatus_ != rtk::StatusCode::Ok) \
+      return rtk::StatusCode::InitializationError;    \
+  } while (0)
+
+void ZeroedPagePool::init() const {
+  auto memResult = kernel_.virtualMemoryAllocator().allocatePages(
+      1, VirtualRegion::MemoryMaps, 0);
+  if (!memResult) {
+    initializationStatus_ = memResult.status();
+    return;
+  }
+  scratch_ = memResult.get().address;
+  initializationStatus_ = rtk::StatusCode::Ok;
+}
+
+rtk::StatusCode ZeroedPagePool::zero(uintptr_t frame) const {
+  // Remapping a present entry invalidates the old translation on this CPU
+  auto status = kernel_.pageTables().map(scratch_, frame,
+                                         PageAttr::Present | PageAttr::RW);
+  CHECK_STATUS();
+  ZeroPage(scratch_);
+  return rtk::StatusCode::Ok;
+}
+
+rtk::StatusOr<uintptr_t> ZeroedPagePool::allocatePage() const {
+  CHECK_INIT_STATUS();
+
+  InterruptGuard noInterrupts;
+  LockGuard guard{lock_};
+
+  if (count_ > 0) {
+    return frames_[--count_];
+  }
+
+  // Pool ran dry: pay for the zeroing now
+  auto result = kernel_.pageAllocator().allocatePage();
+  if (!result)
+    return result;  // out of mem?
+  auto status = zero(result.get());
+  if (status != rtk::StatusCode::Ok) {
+    (void)kernel_.pageAllocator().freePages(
+        PageSet{kPageSize, result.get(), 1});
+    return status;
+  }
+  return result;
+}
+
+void ZeroedPagePool::freePage(uintptr_t frame) const {
+  {
+    InterruptGuard noInterrupts;
+    LockGuard guard{lock_};
+    if (count_ < kCapacity) {
+      frames_[count_++] = frame;
+      return;
+    }
+  }
+  (void)kernel_.pageAllocator().freePages(PageSet{kPageSize, frame, 1});
+}
+
+bool ZeroedPagePool::fill(size_t count) const {
+  if (initializationStatus_ != rtk::StatusCode::Ok)
+    return false;
+
+  // One frame per lock hold, so a fault never waits on more than one page
+  for (size_t i = 0; i < count; i++) {
+    InterruptGuard noInterrupts;
+    LockGuard guard{lock_};
+
+    if (count_ == kCapacity)
+      return false;
+    auto result = kernel_.pageAllocator().allocatePage();
+    if (!result)
+      return false;  // out of mem? leave what's left to the faults
+    if (zero(result.get()) != rtk::StatusCode::Ok) {
+      (void)kernel_.pageAllocator().freePages(
+          PageSet{kPageSize, result.get(), 1});
+      return false;
+    }
+    frames_[count_++] = result.get();
+  }
+  return true;
+}
+
+rtk::StatusOr<PageSet> DemandPagedHeap::reserve(size_t count) const {
+  // Guard pages are never reserved, so an overrun faults and isn't backed
+  return kernel_.virtualMemoryAllocator().allocatePages(
+      count, VirtualRegion::Heap, 1);
+}
+
+rtk::StatusCode DemandPagedHeap::release(PageSet pages) const {
+  const auto& tables = kernel_.pageTables();
+  const auto count = pages.count * (pages.pageSize / kPageSize);
+  if (count == 0 || !kernel_.virtualMemoryAllocator().contains(pages.address))
+    return rtk::StatusCode::OutOfRange;
+
+  // A frame can only be reused once no TLB maps it any more, so unmap and
+  // flush a batch of pages before freeing their frames
+  uintptr_t frames[TlbFlushBatch::kMaxPages];
+  for (size_t done = 0; done < count;) {
+    const auto address = pages.address + done * kPageSize;
+    auto batch = count - done;
+    if (batch > TlbFlushBatch::kMaxPages) {
+      batch = TlbFlushBatch::kMaxPages;
+    }
+
+    size_t backed = 0;
+    {
+      InterruptGuard noInterrupts;
+      LockGuard guard{lock_};
+      TlbFlushBatch flush;
+      for (size_t i = 0; i < batch; i++) {
+        auto frame = tables.translate(address + i * kPageSize);
+        if (frame.ok()) {
+          frames[backed++] = frame.get();
+        }
+      }
+      if (backed > 0) {
+        auto status = tables.unmap(batch, address, flush);
+        CHECK_STATUS();
+      }
+    }
+
+    for (size_t i = 0; i < backed; i++) {
+      (void)kernel_.pageAllocator().freePages(
+          PageSet{kPageSize, frames[i], 1});
+    }
+    done += batch;
+  }
+
+  return kernel_.virtualMemoryAllocator().freePages(pages);
+}
+
+rtk::StatusCode DemandPagedHeap::handleFault(uintptr_t address,
+                                             uint64_t errorCode) const {
+  // Only kernel accesses to pages that aren't there yet are ours
+  if ((errorCode &
+       (kPageFaultPresent | kPageFaultUser | kPageFaultReserved)) != 0)
+    return rtk::StatusCode::OutOfRange;
+
+  const auto& layout = kernel_.memoryLayout();
+  if (address < layout.heapStart() || address > layout.heapEnd() ||
+      !kernel_.virtualMemoryAllocator().contains(address))
+    return rtk::StatusCode::OutOfRange;
+
+  const auto page = address & ~(kPageSize - 1);
+  const auto& tables = kernel_.pageTables();
+
+  LockGuard guard{lock_};
+
+  // Another CPU touched the same page first
+  if (tables.translate(page).ok())
+    return rtk::StatusCode::Ok;
+
+  auto frame = zeroedPages_.allocatePage();
+  if (!frame)
+    return frame.status();  // out of mem?
+
+  auto status =
+      tables.map(page, frame.get(), PageAttr::Present | PageAttr::RW);
+  if (status != rtk::StatusCode::Ok) {
+    zeroedPages_.freePage(frame.get());
+  }
+  return status;
+}
@@ -1 +1,347 @@
 #include "kernel/heap.h"
+
+#include "kernel.h"
+
+using namespace k;
+
+static_assert(SlabAllocator::classSize(SlabAllocator::kClassCount - 1) ==
+              SlabAllocator::kMaxSmallSize);
+
+namespace {
+constexpr size_t kLookupSlots =
+    SlabAllocator::kMaxSmallSize / SlabAllocator::kAlignment + 1;
+
+// Size class for each multiple of kAlignment, so lookup is one load
+struct ClassLookup {
+  uint8_t index[kLookupSlots];
+
+  constexpr ClassLookup() : index{} {
+    int sizeClass = 0;
+    for (size_t slot = 0; slot < kLookupSlots; slot++) {
+      while (SlabAllocator::classSize(sizeClass) <
+             slot * SlabAllocator::kAlignment) {
+        sizeClass++;
+      }
+      index[slot] = static_cast<uint8_t>(sizeClass);
+    }
+  }
+};
+constexpr ClassLookup kClassLookup;
+}  // namespace
+
+int SlabAllocator::classFor(size_t size) {
+  return kClassLookup.index[(size + kAlignment - 1) / kAlignment];
+}
+
+void SlabAllocator::link(SizeClass& sizeClass, Slab* slab) {
+  slab->prev = nullptr;
+  slab->next = sizeClass.partial;
+  if (sizeClass.partial != nullptr) {
+    sizeClass.partial->prev = slab;
+  }
+  sizeClass.partial = slab;
+}
+
+void SlabAllocator::unlink(SizeClass& sizeClass, Slab* slab) {
+  if (slab->prev != nullptr) {
+    slab->prev->next = slab->next;
+  } else {
+    sizeClass.partial = slab->next;
+  }
+  if (slab->next != nullptr) {
+    slab->next->prev = slab->prev;
+  }
+}
+
+rtk::StatusOr<SlabAllocator::Slab*> SlabAllocator::newSlab(int index) const {
+  auto pageResult = kernel_.virtualMemoryAllocator().allocatePage();
+  if (!pageResult)
+    return pageResult.status();  // out of address space?
+  const auto page = pageResult.get();
+
+  auto frameResult = kernel_.pageAllocator().allocatePage();
+  if (!frameResult) {
+    (void)kernel_.virtualMemoryAllocator().freePages(
+        PageSet{kPageSize, page, 1});
+    return frameResult.status();  // out of mem?
+  }
+
+  auto status = kernel_.pageTables().map(page, frameResult.get(),
+                                         PageAttr::Present | PageAttr::RW);
+  if (status != rtk::StatusCode::Ok) {
+    (void)kernel_.pageAllocator().freePages(
+        PageSet{kPageSize, frameResult.get(), 1});
+    (void)kernel_.virtualMemoryAllocator().freePages(
+        PageSet{kPageSize, page, 1});
+    return status;
+  }
+
+  auto slab = reinterpret_cast<Slab*>(page);
+  slab->magic = kSlabMagic;
+  slab->sizeClass = static_cast<uint16_t>(index);
+  slab->inUse = 0;
+  slab->frame = frameResult.get();
+
+  // Thread the objects in address order, so the first ones out share lines
+  const auto size = classSize(index);
+  const auto count = (kPageSize - kHeaderSize) / size;
+  FreeObject** tail = &slab->free;
+  for (size_t i = 0; i < count; i++) {
+    auto object = reinterpret_cast<FreeObject*>(page + kHeaderSize + i * size);
+    *tail = object;
+    tail = &object->next;
+  }
+  *tail = nullptr;
+
+  return slab;
+}
+
+void SlabAllocator::releaseSlab(Slab* slab) const {
+  const auto page = reinterpret_cast<uintptr_t>(slab);
+  const auto frame = slab->frame;
+
+  // Nothing may map the frame by the time it's reused
+  (void)kernel_.pageTables().unmap(1, page);
+  (void)kernel_.pageAllocator().freePages(PageSet{kPageSize, frame, 1});
+  (void)kernel_.virtualMemoryAllocator().freePages(
+      PageSet{kPageSize, page, 1});
+}
+
+rtk::StatusOr<void*> SlabAllocator::allocateLarge(size_t size) const {
+  if (size > SIZE_MAX - kHeaderSize - kPageSize)
+    return rtk::StatusCode::OutOfRange;
+
+  const auto pages = (size + kHeaderSize + kPageSize - 1) / kPageSize;
+  auto result = kernel_.heap().reserve(pages);
+  if (!result)
+    return result.status();  // out of address space?
+
+  // Writing the header faults in the first page; the rest follow on use
+  auto block = reinterpret_cast<Slab*>(result.get().address);
+  block->magic = kLargeMagic;
+  block->pages = result.get();
+  return reinterpret_cast<void*>(result.get().address + kHeaderSize);
+}
+
+rtk::StatusOr<void*> SlabAllocator::allocateFromSlab(int index) const {
+  auto& sizeClass = classes_[index];
+  LockGuard guard{sizeClass.lock};
+
+  auto slab = sizeClass.partial;
+  if (slab == nullptr) {
+    slab = sizeClass.empty;
+    if (slab != nullptr) {
+      sizeClass.empty = nullptr;
+    } else {
+      auto result = newSlab(index);
+      if (!result)
+        return result.status();  // out of mem?
+      slab = result.get();
+    }
+    link(sizeClass, slab);
+  }
+
+  auto object = slab->free;
+  slab->free = object->next;
+  slab->inUse++;
+  if (slab->free == nullptr) {
+    unlink(sizeClass, slab);  // full slabs aren't listed anywhere
+  }
+  return reinterpret_cast<void*>(object);
+}
+
+void SlabAllocator::freeToSlab(void* ptr) const {
+  const auto page = reinterpret_cast<uintptr_t>(ptr) & ~(kPageSize - 1);
+  auto slab = reinterpret_cast<Slab*>(page);
+  auto& sizeClass = classes_[slab->sizeClass];
+
+  const auto wasFull = slab->free == nullptr;
+  auto object = reinterpret_cast<FreeObject*>(ptr);
+  object->next = slab->free;
+  slab->free = object;
+  slab->inUse--;
+
+  if (slab->inUse == 0) {
+    if (!wasFull) {
+      unlink(sizeClass, slab);
+    }
+    if (sizeClass.empty == nullptr) {
+      sizeClass.empty = slab;
+    } else {
+      releaseSlab(slab);
+    }
+  } else if (wasFull) {
+    link(sizeClass, slab);
+  }
+}
+
+SlabAllocator::CpuCache* SlabAllocator::localCache(int index) const {
+  const auto cpu = CurrentCpu();
+  if (cpu >= kMaxCpus)
+    return nullptr;
+  return &cpus_[cpu].classes[index];
+}
+
+void* SlabAllocator::popLocal(int index) const {
+  auto cache = localCache(index);
+  if (cache == nullptr)
+    return nullptr;
+
+  auto loaded = cache->loaded;
+  if (loaded == nullptr || loaded->rounds == 0) {
+    auto previous = cache->previous;
+    if (previous != nullptr && previous->rounds > 0) {
+      cache->previous = loaded;
+      cache->loaded = previous;
+    } else {
+      // Both empty: trade the previous one for a full one from the depot
+      auto& sizeClass = classes_[index];
+      LockGuard guard{sizeClass.lock};
+      auto full = sizeClass.full;
+      if (full == nullptr)
+        return nullptr;
+      sizeClass.full = full->next;
+      sizeClass.fullCount--;
+      if (previous != nullptr) {
+        previous->next = sizeClass.emptyMagazines;
+        sizeClass.emptyMagazines = previous;
+      }
+      cache->previous = loaded;
+      cache->loaded = full;
+    }
+  }
+
+  loaded = cache->loaded;
+  return loaded->objects[--loaded->rounds];
+}
+
+bool SlabAllocator::pushLocal(int index, void* ptr) const {
+  auto cache = localCache(index);
+  if (cache == nullptr)
+    return false;
+
+  auto loaded = cache->loaded;
+  if (loaded == nullptr || loaded->rounds == kMagazineRounds) {
+    auto previous = cache->previous;
+    if (previous != nullptr && previous->rounds == 0) {
+      cache->previous = loaded;
+      cache->loaded = previous;
+    } else {
+      // Both full (or missing): the previous one goes to the depot
+      auto empty = exchangeEmpty(index, previous);
+      if (empty == nullptr)
+        return false;
+      cache->previous = loaded;
+      cache->loaded = empty;
+    }
+  }
+
+  loaded = cache->loaded;
+  loaded->objects[loaded->rounds++] = ptr;
+  return true;
+}
+
+SlabAllocator::Magazine* SlabAllocator::exchangeEmpty(int index,
+                                                      Magazine* full) const {
+  auto& sizeClass = classes_[index];
+  {
+    LockGuard guard{sizeClass.lock};
+
+    // The depot has plenty: hand the objects back and reuse the magazine
+    if (full != nullptr && sizeClass.fullCount >= kDepotLimit) {
+      for (size_t i = 0; i < full->rounds; i++) {
+        freeToSlab(full->objects[i]);
+      }
+      full->rounds = 0;
+      return full;
+    }
+
+    auto empty = sizeClass.emptyMagazines;
+    if (empty != nullptr) {
+      sizeClass.emptyMagazines = empty->next;
+      if (full != nullptr) {
+        full->next = sizeClass.full;
+        sizeClass.full = full;
+        sizeClass.fullCount++;
+      }
+      return empty;
+    }
+  }
+
+  // Magazines come straight from the slabs, never from magazines
+  auto result = allocateFromSlab(classFor(sizeof(Magazine)));
+  if (!result)
+    return nullptr;  // out of mem?
+  auto empty = reinterpret_cast<Magazine*>(result.get());
+  empty->rounds = 0;
+
+  if (full != nullptr) {
+    LockGuard guard{sizeClass.lock};
+    full->next = sizeClass.full;
+    sizeClass.full = full;
+    sizeClass.fullCount++;
+  }
+  return empty;
+}
+
+rtk::StatusOr<void*> SlabAllocator::allocate(size_t size,
+                                             const void* site) const {
+  if (site == nullptr) {
+    site = __builtin_return_address(0);
+  }
+  if (size > kMaxSmallSize) {
+    auto result = allocateLarge(size);
+    if (result.ok()) {
+      profiler_.recordAllocation(result.get(), size, kClassCount, site);
+    }
+    return result;
+  }
+
+  const auto index = classFor(size == 0 ? 1 : size);
+
+  InterruptGuard noInterrupts;
+  auto object = popLocal(index);
+  if (object == nullptr) {
+    auto result = allocateFromSlab(index);
+    if (!result)
+      return result.status();  // out of mem?
+    object = result.get();
+  }
+  profiler_.recordAllocation(object, classSize(index), index, site);
+  return object;
+}
+
+void SlabAllocator::free(void* ptr) const {
+  if (ptr == nullptr)
+    return;
+  profiler_.recordFree(ptr);
+
+  const auto page = reinterpret_cast<uintptr_t>(ptr) & ~(kPageSize - 1);
+  auto slab = reinterpret_cast<Slab*>(page);
+  if (slab->magic == kLargeMagic) {
+    (void)kernel_.heap().release(slab->pages);
+    return;
+  }
+
+  InterruptGuard noInterrupts;
+  if (pushLocal(slab->sizeClass, ptr))
+    return;
+
+  LockGuard guard{classes_[slab->sizeClass].lock};
+  freeToSlab(ptr);
+}
+
+void* PageResource::allocate(size_t bytes, size_t alignment) {
+  if (bytes == 0 || alignment > kPageSize || bytes > SIZE_MAX - kPageSize)
+    return nullptr;
+  auto result = heap_.reserve((bytes + kPageSize - 1) / kPageSize);
+  if (!result)
+    return nullptr;  // out of address space?
+  return reinterpret_cast<void*>(result.get().address);
+}
+
+void PageResource::deallocate(void* ptr, size_t bytes, size_t) {
+  const auto pages = (bytes + kPageSize - 1) / kPageSize;
+  (void)heap_.release(
+      PageSet{kPageSize, reinterpret_cast<uintptr_t>(ptr), pages});
+}
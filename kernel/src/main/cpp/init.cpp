@@ -1,4 +1,5 @@
 #include "kernel.h"
+#include "kernel/interrupts.h"
 
 #include "core/stdlib/freestanding/new.h"
 
@@ -12,9 +13,21 @@ alignas(DefaultKernelContext) static uint8_t
 KernelContext* KernelContext::context = nullptr;
 
 const KernelContext& k::CreateContext(KernelBootstrapper& bootstrapper) {
+  // The boot CPU is CPU 0; per-CPU caches look it up through GS
+  InitCpuLocal(0);
+  DetectCpuFeatures();
+  SelectMemoryRoutines();
+  InitCpuPaging();
+
   // Create the kernel context, in place of the buffer, passing in parameters
   KernelContext::context = new (::kernelBuf) DefaultKernelContext{bootstrapper};
 
+  // Timed on memory from the context's allocators
+  SelectPageRoutines(*KernelContext::context);
+
+  // Heap page faults need the context
+  InitInterrupts();
+
   return *KernelContext::context;
 }
 
@@ -24,11 +37,18 @@ const KernelContext& k::Context() {
 
 DefaultKernelContext::DefaultKernelContext(KernelBootstrapper& bootstrapper)
     : pageAllocator_{bootstrapper.memoryBootstrapper()},
+      pageCache_{pageAllocator_, bootstrapper.cpuCount()},
       pageAllocatorPtr_(
           &bootstrapper.memoryBootstrapper().bootstrapAllocator()),
       virtualMemoryAllocator_{},
-      pageTables_{memoryLayout_, pageAllocator_,  //virtualMemoryAllocator_,
-                  bootstrapper.memoryBootstrapper()} {
+      pageTables_{memoryLayout_, *this,  //virtualMemoryAllocator_,
+                  bootstrapper.memoryBootstrapper()},
+      heap_{*this},
+      allocator_{*this} {
   pageAllocator_.init(this, bootstrapper.memoryBootstrapper());
-  pageAllocatorPtr_ = &pageAllocator_;
+  pageAllocatorPtr_ = &pageCache_;
+
+  // Last user of the bootstrapper's address space bump pointer
+  virtualMemoryAllocator_.init(this, bootstrapper.memoryBootstrapper());
+  heap_.init();
 }
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "kernel/interrupts.h"
+
+#include "kernel.h"
+
+using namespace k;
+
+namespace {
+constexpr int kIdtEntries = 256;
+constexpr int kExceptionVectors = 32;
+constexpr uint8_t kInterruptGate = 0x8E;  // present, DPL 0, 64-bit gate
+
+struct __attribute__((packed)) IdtGate {
+  uint16_t offsetLow;
+  uint16_t selector;
+  uint8_t ist;
+  uint8_t type;
+  uint16_t offsetMid;
+  uint32_t offsetHigh;
+  uint32_t reserved;
+};
+static_assert(sizeof(IdtGate) == 16, "IDT gates are 16 bytes");
+
+// Shared by every CPU; entries never change after the first InitInterrupts
+alignas(16) IdtGate idt[kIdtEntries];
+
+IdtGate gateFor(void (*handler)(), uint16_t selector) {
+  const auto offset = reinterpret_cast<uintptr_t>(handler);
+  return IdtGate{static_cast<uint16_t>(offset),
+                 selector,
+                 0,
+                 kInterruptGate,
+                 static_cast<uint16_t>(offset >> 16),
+                 static_cast<uint32_t>(offset >> 32),
+                 0};
+}
+}  // namespace
+
+void k::InitInterrupts() {
+  // Keep whatever code segment the loader left us in
+  const auto selector = read_cs();
+  for (int vector = 0; vector < kExceptionVectors; vector++) {
+    idt[vector] = gateFor(halt_on_trap, selector);
+  }
+  idt[kPageFaultVector] = gateFor(page_fault_entry, selector);
+
+  load_idt(idt, sizeof(idt) - 1);
+}
+
+// Called from page_fault_entry with interrupts disabled
+extern "C" void handle_page_fault(uint64_t errorCode, uintptr_t address) {
+  if (Context().heap().handleFault(address, errorCode) == rtk::StatusCode::Ok)
+    return;
+
+  // Not a first touch of the heap: a kernel bug, so stop here
+  freeze();
+}
@@ -1,22 +1,223 @@
 #include <stddef.h>
+#include <stdint.h>
 
+#include "core/stdlib/cstring.h"
 #include "kernel.h"
 
+namespace {
+// Unaligned 16-, 8-, 4- and 2-byte accesses. SSE2 is part of amd64, and
+// interrupt entry saves the SSE state, so the kernel may always use it.
+typedef long long Chunk
+    __attribute__((vector_size(16), aligned(1), may_alias));
+typedef long long AlignedChunk __attribute__((vector_size(16), may_alias));
+typedef uint64_t Word __attribute__((aligned(1), may_alias));
+typedef uint32_t Word32 __attribute__((aligned(1), may_alias));
+typedef uint16_t Word16 __attribute__((aligned(1), may_alias));
+
+// Sizes from which rep movsb/stosb beat the SSE2 loops, given ERMS
+constexpr size_t kRepCopyThreshold = 2048;
+constexpr size_t kRepFillThreshold = 1024;
+// Fills bigger than the last-level cache go around it: they'd only push
+// out everything else, and their own start before it's read back. This
+// guess stands in when CPUID doesn't give the size.
+constexpr size_t kDefaultNonTemporalThreshold = 4 * 1024 * 1024;
+
+bool useRep = false;
+size_t nonTemporalThreshold = kDefaultNonTemporalThreshold;
+
+inline Chunk Load(const unsigned char* p) {
+  return *reinterpret_cast<const Chunk*>(p);
+}
+inline void Store(unsigned char* p, Chunk c) {
+  *reinterpret_cast<Chunk*>(p) = c;
+}
+inline void StoreAligned(unsigned char* p, Chunk c) {
+  *reinterpret_cast<AlignedChunk*>(p) = c;
+}
+
+// Up to 64 bytes as a few overlapping accesses. Everything is loaded
+// before anything is stored, so the ranges may overlap.
+void CopySmall(unsigned char* d, const unsigned char* s, size_t n) {
+  if (n >= 32) {
+    auto a = Load(s), b = Load(s + 16);
+    auto c = Load(s + n - 32), e = Load(s + n - 16);
+    Store(d, a);
+    Store(d + 16, b);
+    Store(d + n - 32, c);
+    Store(d + n - 16, e);
+  } else if (n >= 16) {
+    auto a = Load(s), b = Load(s + n - 16);
+    Store(d, a);
+    Store(d + n - 16, b);
+  } else if (n >= 8) {
+    auto a = *reinterpret_cast<const Word*>(s);
+    auto b = *reinterpret_cast<const Word*>(s + n - 8);
+    *reinterpret_cast<Word*>(d) = a;
+    *reinterpret_cast<Word*>(d + n - 8) = b;
+  } else if (n >= 4) {
+    auto a = *reinterpret_cast<const Word32*>(s);
+    auto b = *reinterpret_cast<const Word32*>(s + n - 4);
+    *reinterpret_cast<Word32*>(d) = a;
+    *reinterpret_cast<Word32*>(d + n - 4) = b;
+  } else if (n >= 2) {
+    auto a = *reinterpret_cast<const Word16*>(s);
+    auto b = *reinterpret_cast<const Word16*>(s + n - 2);
+    *reinterpret_cast<Word16*>(d) = a;
+    *reinterpret_cast<Word16*>(d + n - 2) = b;
+  } else if (n == 1) {
+    *d = *s;
+  }
+}
+
+// More than 64 bytes, front to back, 64 at a time into aligned stores. The
+// first and last chunks are loaded up front and stored last, so this is
+// also safe when `d` is below an overlapping `s`.
+void CopyForward(unsigned char* d, const unsigned char* s, size_t n) {
+  const auto head = Load(s);
+  const auto tail0 = Load(s + n - 64), tail1 = Load(s + n - 48);
+  const auto tail2 = Load(s + n - 32), tail3 = Load(s + n - 16);
+  auto i = 16 - (reinterpret_cast<uintptr_t>(d) & 15);
+  for (; i + 64 <= n; i += 64) {
+    auto a = Load(s + i), b = Load(s + i + 16);
+    auto c = Load(s + i + 32), e = Load(s + i + 48);
+    StoreAligned(d + i, a);
+    StoreAligned(d + i + 16, b);
+    StoreAligned(d + i + 32, c);
+    StoreAligned(d + i + 48, e);
+  }
+  Store(d, head);
+  Store(d + n - 64, tail0);
+  Store(d + n - 48, tail1);
+  Store(d + n - 32, tail2);
+  Store(d + n - 16, tail3);
+}
+
+// The mirror image, for `d` above an overlapping `s`
+void CopyBackward(unsigned char* d, const unsigned char* s, size_t n) {
+  const auto head0 = Load(s), head1 = Load(s + 16);
+  const auto head2 = Load(s + 32), head3 = Load(s + 48);
+  const auto tail = Load(s + n - 16);
+  auto end = n - (reinterpret_cast<uintptr_t>(d + n) & 15);
+  for (; end > 64; end -= 64) {
+    auto a = Load(s + end - 64), b = Load(s + end - 48);
+    auto c = Load(s + end - 32), e = Load(s + end - 16);
+    StoreAligned(d + end - 64, a);
+    StoreAligned(d + end - 48, b);
+    StoreAligned(d + end - 32, c);
+    StoreAligned(d + end - 16, e);
+  }
+  Store(d + n - 16, tail);
+  Store(d, head0);
+  Store(d + 16, head1);
+  Store(d + 32, head2);
+  Store(d + 48, head3);
+}
+
+void FillSmall(unsigned char* d, uint64_t pattern, size_t n) {
+  const Chunk chunk = {(long long)pattern, (long long)pattern};
+  if (n >= 32) {
+    Store(d, chunk);
+    Store(d + 16, chunk);
+    Store(d + n - 32, chunk);
+    Store(d + n - 16, chunk);
+  } else if (n >= 16) {
+    Store(d, chunk);
+    Store(d + n - 16, chunk);
+  } else if (n >= 8) {
+    *reinterpret_cast<Word*>(d) = pattern;
+    *reinterpret_cast<Word*>(d + n - 8) = pattern;
+  } else if (n >= 4) {
+    *reinterpret_cast<Word32*>(d) = (uint32_t)pattern;
+    *reinterpret_cast<Word32*>(d + n - 4) = (uint32_t)pattern;
+  } else if (n >= 2) {
+    *reinterpret_cast<Word16*>(d) = (uint16_t)pattern;
+    *reinterpret_cast<Word16*>(d + n - 2) = (uint16_t)pattern;
+  } else if (n == 1) {
+    *d = (uint8_t)pattern;
+  }
+}
+
+// More than 64 bytes
+void FillLoop(unsigned char* d, uint64_t pattern, size_t n) {
+  const Chunk chunk = {(long long)pattern, (long long)pattern};
+  Store(d, chunk);
+  auto i = 16 - (reinterpret_cast<uintptr_t>(d) & 15);
+  for (; i + 64 <= n; i += 64) {
+    StoreAligned(d + i, chunk);
+    StoreAligned(d + i + 16, chunk);
+    StoreAligned(d + i + 32, chunk);
+    StoreAligned(d + i + 48, chunk);
+  }
+  FillSmall(d + n - 64, pattern, 64);
+}
+
+// At least nonTemporalThreshold bytes: an aligned middle of whole 64-byte
+// lines straight to memory, and the ragged ends through the caches
+void FillNonTemporal(unsigned char* d, uint64_t pattern, size_t n) {
+  const auto start = (reinterpret_cast<uintptr_t>(d) + 63) & ~(uintptr_t)63;
+  const auto end = (reinterpret_cast<uintptr_t>(d) + n) & ~(uintptr_t)63;
+  FillSmall(d, pattern, 64);
+  fill_nontemporal(reinterpret_cast<void*>(start), pattern, end - start);
+  FillSmall(d + n - 64, pattern, 64);
+}
+}  // namespace
+
+void k::SelectMemoryRoutines() {
+  useRep = Features().erms;
+  if (Features().lastLevelCache != 0) {
+    nonTemporalThreshold = Features().lastLevelCache;
+  }
+}
+
 // <cstring>
 namespace rtk {
 extern "C" {
 void* memcpy(void* dest, const void* src, size_t n) {
   auto d = static_cast<unsigned char*>(dest);
   auto s = static_cast<const unsigned char*>(src);
-  while (n--) {
-    *d++ = *s++;
+  if (n <= 64) {
+    CopySmall(d, s, n);
+  } else if (useRep && n >= kRepCopyThreshold) {
+    copy_bytes(d, s, n);
+  } else {
+    CopyForward(d, s, n);
+  }
+  return dest;
+}
+
+void* memmove(void* dest, const void* src, size_t n) {
+  auto d = static_cast<unsigned char*>(dest);
+  auto s = static_cast<const unsigned char*>(src);
+  if (n <= 64) {
+    CopySmall(d, s, n);
+  } else if (reinterpret_cast<uintptr_t>(d) - reinterpret_cast<uintptr_t>(s) <
+             n) {
+    CopyBackward(d, s, n);
+  } else if (useRep && n >= kRepCopyThreshold) {
+    copy_bytes(d, s, n);  // front to back is fine for d below s
+  } else {
+    CopyForward(d, s, n);
   }
   return dest;
 }
 
 void memset(void* dest, unsigned char val, size_t n) {
-  for (size_t i = 0; i < n; i++)
-    ((unsigned char*)dest)[i] = val;
+  auto d = static_cast<unsigned char*>(dest);
+  const auto pattern = val * 0x0101010101010101ULL;
+  if (n <= 64) {
+    FillSmall(d, pattern, n);
+  } else if (n >= nonTemporalThreshold) {
+    FillNonTemporal(d, pattern, n);
+  } else if (useRep && n >= kRepFillThreshold) {
+    fill_bytes(d, val, n);
+  } else {
+    FillLoop(d, pattern, n);
+  }
 }
 }  // extern "C"
-}  // namespace rtk
\ No newline at end of file
+}  // namespace rtk
+
+// C linkage for compiler-generated calls; see core/stdlib/cstring.h
+extern "C" int memcmp(const void* a, const void* b, size_t n) {
+  return rtk::memcmp(a, b, n);
+}
@@ -1 +1,48 @@
 #include "new.h"
+
+// <new>
+// Kernel heap; usable once CreateContext has returned. Plain new never
+// returns nullptr, as the compiler assumes when it runs the constructor:
+// running out of memory stops the kernel. new (std::nothrow) returns
+// nullptr instead, for callers that can cope.
+namespace {
+// `site` is the caller of new, for the heap profiler
+void* Allocate(size_t size, const void* site) {
+  auto result = k::Context().allocator().allocate(size, site);
+  return result.ok() ? result.get() : nullptr;
+}
+
+void* AllocateOrFreeze(size_t size, const void* site) {
+  auto ptr = Allocate(size, site);
+  if (ptr == nullptr)
+    freeze();  // out of memory
+  return ptr;
+}
+}  // namespace
+
+const std::nothrow_t std::nothrow{};
+
+void* operator new(size_t size) {
+  return AllocateOrFreeze(size, __builtin_return_address(0));
+}
+void* operator new[](size_t size) {
+  return AllocateOrFreeze(size, __builtin_return_address(0));
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size, __builtin_return_address(0));
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size, __builtin_return_address(0));
+}
+void operator delete(void* ptr) noexcept {
+  k::Context().allocator().free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+  k::Context().allocator().free(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+  k::Context().allocator().free(ptr);
+}
+void operator delete[](void* ptr, size_t) noexcept {
+  k::Context().allocator().free(ptr);
+}
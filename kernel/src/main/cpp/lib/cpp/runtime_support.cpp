@@ -5,8 +5,6 @@ void* operator new(size_t, void* ptr) noexcept {
   return ptr;
 }
 void operator delete(void*, void*) noexcept {}  // no-op
-void operator delete(void*) noexcept {}
-void operator delete(void*, size_t) noexcept {}
 
 extern "C" void
 __cxa_deleted_virtual() { /* Fail: can't call deleted virtual method */ }
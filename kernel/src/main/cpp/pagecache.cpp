@@ -0,0 +1,133 @@
+#include "kernel.h"
+
+using namespace k;
+
+PerCpuPageCache::PerCpuPageCache(const PhysicalMemoryAllocator& backing,
+                                 size_t cpuCount)
+    : backing_(backing),
+      cpuCount_(cpuCount < kMaxCpus ? cpuCount : kMaxCpus) {
+  for (auto& magazine : magazines_) {
+    magazine.count = 0;
+  }
+}
+
+PerCpuPageCache::Magazine* PerCpuPageCache::localMagazine() const {
+  const auto cpu = CurrentCpu();
+  return cpu < cpuCount_ ? &magazines_[cpu] : nullptr;
+}
+
+void PerCpuPageCache::refill(Magazine& magazine) const {
+  LockGuard guard{lock_};
+
+  // The backing allocator may hand back a shorter run than asked for
+  while (magazine.count < kBatchSize) {
+    auto result = backing_.allocatePages(kBatchSize - magazine.count);
+    if (!result.ok())
+      return;  // out of mem? keep whatever we got
+    auto pages = result.get();
+
+    // Stack the run so the lowest frame is handed out first
+    for (size_t i = pages.count; i > 0; i--) {
+      magazine.frames[magazine.count++] = pages.address + (i - 1) * kPageSize;
+    }
+  }
+}
+
+void PerCpuPageCache::drain(Magazine& magazine) const {
+  {
+    LockGuard guard{lock_};
+
+    // Give back the oldest frames; the most recently freed are cache-warm.
+    // They all came from backing_, so it has no reason to refuse them.
+    for (size_t i = 0; i < kBatchSize; i++) {
+      (void)backing_.freePage(magazine.frames[i]);
+    }
+  }
+
+  magazine.count -= kBatchSize;
+  for (size_t i = 0; i < magazine.count; i++) {
+    magazine.frames[i] = magazine.frames[i + kBatchSize];
+  }
+}
+
+void PerCpuPageCache::record(const rtk::StatusOr<PageSet>& result,
+                             const void* site) const {
+  if (!result.ok())
+    return;
+  const auto pages = result.get();
+  const auto bytes = pages.count * pages.pageSize;
+  profiler_.recordAllocation(reinterpret_cast<const void*>(pages.address),
+                             bytes, 63 - __builtin_clzll(bytes / kPageSize),
+                             site);
+}
+
+rtk::StatusOr<uintptr_t> PerCpuPageCache::allocatePage() const {
+  auto result = takePage();
+  if (result.ok()) {
+    profiler_.recordAllocation(reinterpret_cast<const void*>(result.get()),
+                               kPageSize, 0, __builtin_return_address(0));
+  }
+  return result;
+}
+
+rtk::StatusOr<uintptr_t> PerCpuPageCache::takePage() const {
+  InterruptGuard noInterrupts;
+
+  auto magazine = localMagazine();
+  if (magazine == nullptr) {
+    LockGuard guard{lock_};
+    return backing_.allocatePage();
+  }
+
+  if (magazine->count == 0) {
+    refill(*magazine);
+    if (magazine->count == 0)
+      return rtk::StatusCode::OutOfMemory;
+  }
+
+  return magazine->frames[--magazine->count];
+}
+
+rtk::StatusOr<PageSet> PerCpuPageCache::allocatePages(size_t count) const {
+  rtk::StatusOr<PageSet> result;
+  if (count == 1) {
+    result = takePage().map(
+        [](auto address) { return PageSet{kPageSize, address, 1}; });
+  } else {
+    InterruptGuard noInterrupts;
+    LockGuard guard{lock_};
+    result = backing_.allocatePages(count);
+  }
+  record(result, __builtin_return_address(0));
+  return result;
+}
+
+rtk::StatusOr<PageSet> PerCpuPageCache::allocateContiguous(
+    size_t count, size_t alignment) const {
+  rtk::StatusOr<PageSet> result;
+  {
+    InterruptGuard noInterrupts;
+    LockGuard guard{lock_};
+    result = backing_.allocateContiguous(count, alignment);
+  }
+  record(result, __builtin_return_address(0));
+  return result;
+}
+
+rtk::StatusCode PerCpuPageCache::freePages(PageSet pages) const {
+  profiler_.recordFree(reinterpret_cast<const void*>(pages.address));
+  InterruptGuard noInterrupts;
+
+  auto magazine = localMagazine();
+  if (magazine == nullptr || pages.count != 1 || pages.pageSize != kPageSize ||
+      pages.address % kPageSize != 0) {
+    LockGuard guard{lock_};
+    return backing_.freePages(pages);
+  }
+
+  if (magazine->count == kMagazineSize) {
+    drain(*magazine);
+  }
+  magazine->frames[magazine->count++] = pages.address;
+  return rtk::StatusCode::Ok;
+}
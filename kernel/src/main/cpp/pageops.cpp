@@ -0,0 +1,133 @@
+#include "kernel/paging.h"
+
+#include "kernel.h"
+
+using namespace k;
+
+namespace {
+using ZeroFn = void (*)(void* dest, size_t bytes);
+using CopyFn = void (*)(void* dest, const void* src, size_t bytes);
+
+// Cached stores, 64 bytes at a time
+void ZeroSse2(void* dest, size_t bytes) {
+  typedef long long Chunk __attribute__((vector_size(16), may_alias));
+  const Chunk zero = {0, 0};
+  auto chunks = static_cast<Chunk*>(dest);
+  for (size_t i = 0; i < bytes / sizeof(Chunk); i += 4) {
+    chunks[i] = zero;
+    chunks[i + 1] = zero;
+    chunks[i + 2] = zero;
+    chunks[i + 3] = zero;
+  }
+}
+void ZeroNonTemporal(void* dest, size_t bytes) {
+  fill_nontemporal(dest, 0, bytes);
+}
+void CopyMemcpy(void* dest, const void* src, size_t bytes) {
+  rtk::memcpy(dest, src, bytes);
+}
+
+constexpr ZeroFn kZeroVariants[] = {zero_pages_stosq, ZeroNonTemporal,
+                                    ZeroSse2};
+constexpr CopyFn kCopyVariants[] = {copy_pages_movsq, copy_pages_nontemporal,
+                                    CopyMemcpy};
+
+ZeroFn zeroPages = zero_pages_stosq;
+CopyFn copyPages = copy_pages_movsq;
+
+constexpr size_t kBenchPages = 8;
+constexpr int kBenchRounds = 4;
+
+// Reads a word of every line, as the pages' first user would. This charges
+// non-temporal stores for the cache misses they leave behind.
+void Touch(const void* pages, size_t bytes) {
+  auto words = static_cast<const volatile uint64_t*>(pages);
+  for (size_t i = 0; i < bytes / sizeof(uint64_t); i += 8) {
+    (void)words[i];
+  }
+}
+
+// Best of kBenchRounds, in cycles, after a warm-up round
+template <typename Run>
+uint64_t Time(Run run) {
+  uint64_t best = UINT64_MAX;
+  for (int round = 0; round <= kBenchRounds; round++) {
+    const auto start = read_tsc();
+    run();
+    const auto cycles = read_tsc() - start;
+    if (round > 0 && cycles < best) {
+      best = cycles;
+    }
+  }
+  return best;
+}
+
+// Picks the fastest variants, timed on 2 * kBenchPages pages at `dest`
+void TimeVariants(uint8_t* dest) {
+  const auto bytes = kBenchPages * kPageSize;
+  const auto src = dest + bytes;
+
+  auto best = UINT64_MAX;
+  for (auto variant : kZeroVariants) {
+    const auto cycles = Time([&] {
+      variant(dest, bytes);
+      Touch(dest, bytes);
+    });
+    if (cycles < best) {
+      best = cycles;
+      zeroPages = variant;
+    }
+  }
+
+  best = UINT64_MAX;
+  for (auto variant : kCopyVariants) {
+    const auto cycles = Time([&] {
+      variant(dest, src, bytes);
+      Touch(dest, bytes);
+    });
+    if (cycles < best) {
+      best = cycles;
+      copyPages = variant;
+    }
+  }
+}
+}  // namespace
+
+void k::ZeroPage(uintptr_t address) {
+  zeroPages(reinterpret_cast<void*>(address), kPageSize);
+}
+
+void k::ZeroPages(PageSet pages) {
+  zeroPages(reinterpret_cast<void*>(pages.address),
+            pages.count * pages.pageSize);
+}
+
+void k::CopyPage(uintptr_t dest, uintptr_t src) {
+  copyPages(reinterpret_cast<void*>(dest), reinterpret_cast<const void*>(src),
+            kPageSize);
+}
+
+void k::SelectPageRoutines(const KernelContext& kernel) {
+  // Destination pages, then source pages, borrowed for the timing
+  const auto count = 2 * kBenchPages;
+  auto frames = kernel.pageAllocator().allocateContiguous(count);
+  if (!frames)
+    return;  // out of mem? keep the defaults
+  auto pages = kernel.virtualMemoryAllocator().allocatePages(
+      count, VirtualRegion::MemoryMaps, 0);
+  if (!pages) {
+    (void)kernel.pageAllocator().freePages(frames.get());
+    return;
+  }
+  const auto address = pages.get().address;
+  const auto& tables = kernel.pageTables();
+  if (tables.map(count, address, frames.get().address,
+                 PageAttr::Present | PageAttr::RW) == rtk::StatusCode::Ok) {
+    TimeVariants(reinterpret_cast<uint8_t*>(address));
+  }
+  // Unmapped and flushed before the frames can go to anyone else
+  (void)tables.unmap(count, address);
+  (void)kernel.virtualMemoryAllocator().freePages(pages.get());
+  (void)kernel.pageAllocator().freePages(frames.get());
+}
+
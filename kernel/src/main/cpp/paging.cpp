@@ -6,13 +6,14 @@ using namespace k;
 
 constexpr auto kBitsPerByte = UINT8_WIDTH;
 constexpr auto kBitsPerPage = kPageSize * kBitsPerByte;
+constexpr auto kBitsPerWord = static_cast<size_t>(UINT64_WIDTH);
 constexpr auto kByteMaskNoBitsSet = (uint8_t)0x00U;
 constexpr auto kByteMaskAllBitsSet = (uint8_t)0xFFU;
 constexpr auto kLongMaskAllBitsSet = 0xFFFFFFFFFFFFFFFFULL;
-constexpr auto kByteMaskRightmostBitSet = (uint8_t)1;
-
-uint8_t makeSetBitsMask(size_t& currentPage, size_t endPage);
-uint8_t makeUnsetBitsMask(size_t& currentPage, size_t endPage);
+constexpr auto kPatBit = static_cast<uintptr_t>(PageAttr::PAT);
+constexpr auto kPsBit = static_cast<uintptr_t>(PageAttr::PS);
+constexpr auto kLargePagePatBit = 1ULL << 12;
+constexpr uint64_t kInvpcidAllContexts = 2;  // Including global entries
 
 #define CHECK_INIT_STATUS()                           \
   do {                                                \
@@ -20,25 +21,76 @@ uint8_t makeUnsetBitsMask(size_t& currentPage, size_t endPage);
       return rtk::StatusCode::InitializationError;    \
   } while (0)
 
+// Entry bits for a large page: PS set, and PAT moved to bit 12 since bit 7
+// is PS
+static inline uintptr_t largePageBits(PageAttr attributes) {
+  auto bits = static_cast<uintptr_t>(attributes);
+  if (bits & kPatBit) {
+    bits = (bits & ~kPatBit) | kLargePagePatBit;
+  }
+  return bits | kPsBit;
+}
+
+// Whether the entry maps memory rather than pointing to another table
+static inline bool isLeaf(const volatile PageEntry& entry, PageLevel level) {
+  return level == PageLevel::PT ||
+         ((level == PageLevel::PD || level == PageLevel::PDP) && entry.ps());
+}
+
 RecursivePageTables::RecursivePageTables(
-    const KernelMemoryLayout& layout, const PhysicalMemoryAllocator& pallocator,
+    const KernelMemoryLayout& layout, const KernelContext& kernel,
     // const VirtualMemoryAllocator& vallocator,
     const MemoryBootstrapper& memoryBootstrapper)
 
     : PageTables(memoryBootstrapper.pageTablePhysicalAddress(),
                  layout.pageTableAddress()),
       tablesStart_{layout.pageTablesStart()},
-      // tablesEnd_{layout.pageTablesEnd()},
-      pallocator_{pallocator} /*,
+      tablesEnd_{layout.pageTablesEnd()},
+      kernelStart_{layout.kernelSpaceStart()},
+      scratchStart_{layout.scratchPagesStart()},
+      kernel_{kernel} /*,
       vallocator_{vallocator}*/
 {}
 
-rtk::StatusCode RecursivePageTables::map(uintptr_t virtAddr, uintptr_t physAddr,
-                                         PageAttr attributes) const {
+rtk::StatusCode PageTables::map(size_t count, uintptr_t vaddr, uintptr_t paddr,
+                                PageAttr attributes) const {
+  while (count > 0) {
+    // Try the largest page the alignment and remaining length allow
+    auto mapped = kPageSize;
+    for (auto level = PageLevel::PDP; level > PageLevel::PT; level--) {
+      const auto size = levelPageSize(level);
+      if (((vaddr | paddr) & (size - 1)) != 0 || count < size / kPageSize)
+        continue;
+      auto status = mapLarge(level, vaddr, paddr, attributes);
+      if (status == rtk::StatusCode::Ok) {
+        mapped = size;
+        break;
+      }
+      if (status != rtk::StatusCode::NotImplemented &&
+          status != rtk::StatusCode::AlreadyExists)
+        return status;
+    }
+
+    if (mapped == kPageSize) {
+      auto leaves = mapLeaves(count, vaddr, paddr, attributes);
+      if (!leaves.ok())
+        return leaves.status();
+      mapped = leaves.get() * kPageSize;
+    }
+
+    vaddr += mapped;
+    paddr += mapped;
+    count -= mapped / kPageSize;
+  }
+  return rtk::StatusCode::Ok;
+}
+
+rtk::StatusOr<volatile PageTable*> RecursivePageTables::walk(
+    uintptr_t virtAddr, PageLevel target) const {
   volatile PageTable* table = &pml4_;
 
-  // Recurse page tables and make sure they exist; find the final page table
-  for (auto level = PageLevel::PML4; level > PageLevel::PT; level--) {
+  // Recurse page tables and make sure they exist; find the target table
+  for (auto level = PageLevel::PML4; level > target; level--) {
     // Get the next entry from the table using the virtual address
     auto idx = entryIndex(virtAddr, level);
     auto entryResult = table->getEntry(idx);
@@ -46,13 +98,17 @@ rtk::StatusCode RecursivePageTables::map(uintptr_t virtAddr, uintptr_t physAddr,
       return entryResult.status();  // out of bounds
     auto entry = entryResult.get();
 
+    // Already covered by a large page; there's no table below to walk into
+    if (entry->present() && entry->ps())
+      return rtk::StatusCode::AlreadyExists;
+
     // Get the subtable by calculating its address, potentially creating it if entry doesn't exist
     // Parameterized subtable addressing is a property of recursive page tables.
     volatile auto subtable =
         (volatile PageTable*)tableAddress(virtAddr, level - 1);
     if (!entry->present()) {
       // Allocate a page for the subtable
-      auto allocateResult = pallocator_.allocatePage();
+      auto allocateResult = kernel_.pageAllocator().allocatePage();
       if (!allocateResult)
         return allocateResult.status();  // out of mem?
       auto subtableNewPaddr = allocateResult.get();
@@ -71,27 +127,263 @@ rtk::StatusCode RecursivePageTables::map(uintptr_t virtAddr, uintptr_t physAddr,
     table = subtable;
   }
 
+  return table;
+}
+
+rtk::StatusCode RecursivePageTables::map(uintptr_t virtAddr, uintptr_t physAddr,
+                                         PageAttr attributes) const {
+  auto walkResult = walk(virtAddr, PageLevel::PT);
+  if (!walkResult.ok())
+    return walkResult.status();
+
   // Set the new entry in the lowest page table (calls invlpg)
-  mapNoTables(virtAddr, physAddr, attributes);
+  mapNoTables(virtAddr, physAddr, withDefaults(virtAddr, attributes));
+
+  return rtk::StatusCode::Ok;
+}
+
+rtk::StatusOr<size_t> RecursivePageTables::mapLeaves(
+    size_t count, uintptr_t virtAddr, uintptr_t physAddr,
+    PageAttr attributes) const {
+  auto walkResult = walk(virtAddr, PageLevel::PT);
+  if (!walkResult.ok())
+    return walkResult.status();
+  auto& table = *walkResult.get();
+
+  attributes = withDefaults(virtAddr, attributes);
+  const auto first = entryIndex(virtAddr, PageLevel::PT);
+  const auto room = PageTable::kNumEntries - first;
+  const auto mapped = count < room ? count : room;
+
+  for (size_t i = 0; i < mapped; i++) {
+    auto& entry = table[first + i];
+    const auto wasPresent = entry.present();
+    entry = PageEntry(physAddr + i * kPageSize, attributes);
+    // Only entries that were present can be in the TLB
+    if (wasPresent)
+      invalidate_page(virtAddr + i * kPageSize);
+  }
+  return mapped;
+}
+
+rtk::StatusCode RecursivePageTables::mapLarge(PageLevel level,
+                                              uintptr_t virtAddr,
+                                              uintptr_t physAddr,
+                                              PageAttr attributes) const {
+  if (level != PageLevel::PD && level != PageLevel::PDP)
+    return rtk::StatusCode::OutOfRange;
+  if (level == PageLevel::PDP && !Features().hugePages)
+    return rtk::StatusCode::NotImplemented;
+
+  const auto size = levelPageSize(level);
+  if (((virtAddr | physAddr) & (size - 1)) != 0)
+    return rtk::StatusCode::OutOfRange;
+
+  auto walkResult = walk(virtAddr, level);
+  if (!walkResult.ok())
+    return walkResult.status();
+  auto entry = walkResult.get()->getEntry(entryIndex(virtAddr, level)).get();
+
+  // Replacing a table would leak it and drop whatever it maps
+  if (entry->present() && !entry->ps())
+    return rtk::StatusCode::AlreadyExists;
+
+  const auto wasPresent = entry->present();
+  *entry =
+      PageEntry(physAddr | largePageBits(withDefaults(virtAddr, attributes)));
+  if (wasPresent)
+    invalidate_page(virtAddr);
+
+  return rtk::StatusCode::Ok;
+}
+
+RecursivePageTables::Leaf RecursivePageTables::find(uintptr_t virtAddr) const {
+  volatile PageTable* table = &pml4_;
+  auto level = PageLevel::PML4;
+  while (true) {
+    auto& entry = (*table)[entryIndex(virtAddr, level)];
+    if (!entry.present() || isLeaf(entry, level))
+      return {&entry, level};
+    level--;
+    table = (volatile PageTable*)tableAddress(virtAddr, level);
+  }
+}
+
+rtk::StatusCode RecursivePageTables::split(uintptr_t virtAddr, PageLevel level,
+                                           volatile PageEntry& entry) const {
+  const auto size = levelPageSize(level);
+  const auto childLevel = level - 1;
+  const auto childSize = levelPageSize(childLevel);
+  const auto physBase = entry.physicalAddress() & ~(size - 1);
+
+  // The same attributes, in the children's encoding
+  auto bits = static_cast<uintptr_t>(entry.attributes());
+  const auto pat = entry.physicalAddress() & kLargePagePatBit;
+  if (childLevel == PageLevel::PT) {
+    bits &= ~kPsBit;
+    if (pat)
+      bits |= kPatBit;
+  } else if (pat) {
+    bits |= kLargePagePatBit;
+  }
+  auto tableAttributes = PageAttr::Present | PageAttr::RW;
+  if (entry.user()) {
+    tableAttributes |= PageAttr::User;
+  }
+
+  auto allocateResult = kernel_.pageAllocator().allocatePage();
+  if (!allocateResult)
+    return allocateResult.status();  // out of mem?
+  const auto frame = allocateResult.get();
+
+  // Fill the table through this CPU's scratch page while the large page
+  // still maps the range, so no walk ever sees it half filled
+  InterruptGuard noInterrupts;
+  const auto scratch = scratchStart_ + CurrentCpu() * kPageSize;
+  auto status = map(scratch, frame, PageAttr::Present | PageAttr::RW);
+  if (status != rtk::StatusCode::Ok) {
+    (void)kernel_.pageAllocator().freePage(frame);
+    return status;
+  }
+  auto subtable = (volatile PageTable*)scratch;
+  for (size_t i = 0; i < PageTable::kNumEntries; i++) {
+    (*subtable)[i] = PageEntry((physBase + i * childSize) | bits);
+  }
+  // No writable alias of a live table left behind
+  ((volatile PageEntry*)entryAddr(scratch))->clear();
+  invalidate_page(scratch);
+
+  // One store swaps the large entry for the table. Both map the range the
+  // same way, so a walk is right whichever it sees.
+  const PageEntry table{frame, tableAttributes};
+  entry = table;
+
+  // Drop the old large translation, and whatever the recursive window
+  // cached where the table now shows up
+  invalidate_page(virtAddr & ~(size - 1));
+  invalidate_page(tableAddress(virtAddr, childLevel));
 
   return rtk::StatusCode::Ok;
 }
 
-uint8_t makeSetBitsMask(size_t& currentPage, size_t endPage) {
-  auto byteMask = kByteMaskNoBitsSet;
-  if (currentPage >= endPage)
-    return 0;
-  do {  // allow first bit to be byte-aligned
-    auto currentBit = currentPage % UINT8_WIDTH;
-    // clear the bit in the mask
-    byteMask |= static_cast<uint8_t>(kByteMaskRightmostBitSet << currentBit);
-    currentPage++;
-  } while (currentPage % UINT8_WIDTH != 0 && currentPage < endPage);
-  return byteMask;
+void RecursivePageTables::releaseEmptyTables(uintptr_t virtAddr,
+                                             PageLevel level) const {
+  // PDPTs always stay, so PML4 entries never change and can be shared
+  // between address spaces
+  for (auto l = level; l < PageLevel::PDP; l++) {
+    auto table = (volatile PageTable*)tableAddress(virtAddr, l);
+    for (size_t i = 0; i < PageTable::kNumEntries; i++) {
+      if ((*table)[i].present())
+        return;
+    }
+
+    // Recursive mapping: the entry that maps the table is its parent entry
+    auto& parent = *(volatile PageEntry*)entryAddr((uintptr_t)table);
+    const auto physAddr = parent.physicalAddress();
+    parent.clear();
+
+    // The frame may be reused as soon as it's freed, so paging-structure
+    // caches can't wait for the batch. With PCIDs invlpg only drops the
+    // current PCID's caches, and kernel tables are shared by every address
+    // space, so flush all contexts (toggling CR4.PGE also does that)
+    if (Features().pcid) {
+      if (Features().invpcid)
+        invpcid(kInvpcidAllContexts, 0, 0);
+      else
+        flush_tlb_all();
+    } else {
+      invalidate_page((uintptr_t)table);
+    }
+    (void)kernel_.pageAllocator().freePage(physAddr);
+  }
 }
 
-uint8_t makeUnsetBitsMask(size_t& currentPage, size_t endPage) {
-  return static_cast<uint8_t>(~makeSetBitsMask(currentPage, endPage));
+rtk::StatusCode RecursivePageTables::unmap(size_t count, uintptr_t virtAddr,
+                                           TlbFlushBatch& flush) const {
+  // Last entry cleared; its table is checked once we move past it
+  auto cleared = uintptr_t{0};
+  auto clearedLevel = PageLevel::PT;
+  auto pending = false;
+
+  while (count > 0) {
+    auto leaf = find(virtAddr);
+    const auto size = levelPageSize(leaf.level);
+    const auto offset = (virtAddr & (size - 1)) / kPageSize;
+    auto pages = size / kPageSize - offset;
+
+    if (leaf.entry->present()) {
+      // Only part of a large page goes; split it and look again
+      if (offset != 0 || count < pages) {
+        auto status = split(virtAddr, leaf.level, *leaf.entry);
+        CHECK_STATUS();
+        continue;
+      }
+      leaf.entry->clear();
+      flush.add(virtAddr);
+      cleared = virtAddr;
+      clearedLevel = leaf.level;
+      pending = true;
+    }
+
+    if (pages > count) {
+      pages = count;
+    }
+    virtAddr += pages * kPageSize;
+    count -= pages;
+
+    const auto tableSize = levelPageSize(clearedLevel + 1);
+    if (pending && (count == 0 || (virtAddr & ~(tableSize - 1)) !=
+                                      (cleared & ~(tableSize - 1)))) {
+      releaseEmptyTables(cleared, clearedLevel);
+      pending = false;
+    }
+  }
+  return rtk::StatusCode::Ok;
+}
+
+rtk::StatusCode RecursivePageTables::protect(size_t count, uintptr_t virtAddr,
+                                             PageAttr attributes,
+                                             TlbFlushBatch& flush) const {
+  attributes = withDefaults(virtAddr, attributes);
+
+  while (count > 0) {
+    auto leaf = find(virtAddr);
+    const auto size = levelPageSize(leaf.level);
+    const auto offset = (virtAddr & (size - 1)) / kPageSize;
+    auto pages = size / kPageSize - offset;
+
+    if (leaf.entry->present()) {
+      if (offset != 0 || count < pages) {
+        auto status = split(virtAddr, leaf.level, *leaf.entry);
+        CHECK_STATUS();
+        continue;
+      }
+      const auto physAddr = leaf.entry->physicalAddress() & ~(size - 1);
+      if (leaf.level == PageLevel::PT) {
+        *leaf.entry = PageEntry(physAddr, attributes);
+      } else {
+        *leaf.entry = PageEntry(physAddr | largePageBits(attributes));
+      }
+      flush.add(virtAddr);
+    }
+
+    if (pages > count) {
+      pages = count;
+    }
+    virtAddr += pages * kPageSize;
+    count -= pages;
+  }
+  return rtk::StatusCode::Ok;
+}
+
+rtk::StatusOr<uintptr_t> RecursivePageTables::translate(
+    uintptr_t virtAddr) const {
+  auto leaf = find(virtAddr);
+  if (!leaf.entry->present())
+    return rtk::StatusCode::ValueNotPresent;
+
+  const auto mask = levelPageSize(leaf.level) - 1;
+  return (leaf.entry->physicalAddress() & ~mask) | (virtAddr & mask);
 }
 
 void DefaultPhysicalMemoryAllocator::init(
@@ -100,9 +392,17 @@ void DefaultPhysicalMemoryAllocator::init(
 
   // Get the page frame bitmap parameters right
   const auto totalMemPages = bootstrapper.memorySize() / kPageSize;
-  auto pagesNeeded =
+  const auto bitmapPages =
       (totalMemPages + kBitsPerPage - 1) / kBitsPerPage;  // round up
-  bitmapSize_ = pagesNeeded * kPageSize;
+  bitmapSize_ = bitmapPages * kPageSize;
+
+  // Summary levels, stored right after the bitmap
+  bitmapWords_ = bitmapSize_ / sizeof(uint64_t);
+  summary1Words_ = (bitmapWords_ + kBitsPerWord - 1) / kBitsPerWord;
+  summary2Words_ = (summary1Words_ + kBitsPerWord - 1) / kBitsPerWord;
+  const auto summaryBytes = (summary1Words_ + summary2Words_) * sizeof(uint64_t);
+  const auto summaryPages = (summaryBytes + kPageSize - 1) / kPageSize;
+  auto pagesNeeded = bitmapPages + summaryPages;
 
   // Reserve our virtual memory space
   auto memResult = bootstrapper.reserveVirtualMemory(pagesNeeded);
@@ -110,7 +410,9 @@ void DefaultPhysicalMemoryAllocator::init(
     return;
 
   const auto bitmapStart = memResult.get();
-  bitmap_ = reinterpret_cast<uint8_t*>(bitmapStart);
+  bitmap_ = reinterpret_cast<uint64_t*>(bitmapStart);
+  summary1_ = bitmap_ + bitmapWords_;
+  summary2_ = summary1_ + summary1Words_;
 
   auto currentPage = bitmapStart;
 
@@ -132,43 +434,31 @@ void DefaultPhysicalMemoryAllocator::init(
     if (status != rtk::StatusCode::Ok)  // out of mem creating tables?
       return;
 
-    // Clear the page (all 1's for "used" by default)
-    rtk::memset(reinterpret_cast<void*>(currentPage), kByteMaskAllBitsSet,
-                kPageSize);
-
     // Advance
     currentPage += bytesAllocated;
     pagesNeeded -= newPages.count;
   }
 
+  // All 1's for "used" by default; no summary bits until pages are freed
+  rtk::memset(bitmap_, kByteMaskAllBitsSet, bitmapSize_);
+  rtk::memset(summary1_, kByteMaskNoBitsSet, summaryBytes);
+
   // Enumerate physical memory and mark where it's free
   for (auto range : bootstrapper.processFreePhysicalMemoryPages()) {
     const auto startPage = range.address / kPageSize;
     auto endPage = startPage + range.count;
-    auto currentPage = startPage;
+    if (endPage > totalMemPages) {
+      endPage = totalMemPages;
+    }
+    if (startPage >= endPage)
+      continue;
 
     // We can initialize the lowest free page number
     if (startPage < lowestFreePage_) {
       lowestFreePage_ = startPage;
     }
 
-    // Build a bitmap for the first byte
-    if (currentPage % UINT8_WIDTH != 0) {
-      auto byteMask = makeUnsetBitsMask(currentPage, endPage);
-      bitmap_[startPage / UINT8_WIDTH] &= byteMask;
-    }
-
-    // Write 0's for whole bytes
-    for (; currentPage + UINT8_WIDTH <= endPage; currentPage += UINT8_WIDTH) {
-      bitmap_[currentPage / UINT8_WIDTH] = kByteMaskNoBitsSet;
-    }
-
-    // final byte
-    if (currentPage < endPage) {
-      auto lastByteIndex = currentPage / UINT8_WIDTH;
-      auto byteMask = makeUnsetBitsMask(currentPage, endPage);
-      bitmap_[lastByteIndex] &= byteMask;
-    }
+    markFree(startPage, endPage);
   }
   initializationStatus_ = rtk::StatusCode::Ok;
 }
@@ -182,34 +472,112 @@ rtk::StatusOr<uintptr_t> DefaultPhysicalMemoryAllocator::allocatePage() const {
   return allocatePages(1).map([](auto pageSet) { return pageSet.address; });
 }
 
-template <typename T>
-bool DefaultPhysicalMemoryAllocator::alignedFreeCheckAdvanceAndMark(
-    size_t& pageNo, size_t count, size_t* pagesAllocated) const {
-  constexpr auto sizeBits = sizeof(T) * kBitsPerByte;
-  const auto pageMapBits = bitmapSize_ * UINT8_WIDTH;
+// Mask of bits [lo, hi) within a single word
+static inline uint64_t wordMask(size_t lo, size_t hi) {
+  const auto width = hi - lo;
+  return width == kBitsPerWord ? kLongMaskAllBitsSet
+                               : ((1ULL << width) - 1) << lo;
+}
 
-  // Bounds check
-  if (pageNo + sizeBits > pageMapBits)
-    return false;
+void DefaultPhysicalMemoryAllocator::updateSummary(size_t word) const {
+  const auto s1 = word / kBitsPerWord;
+  const auto s1Bit = 1ULL << (word % kBitsPerWord);
+  if (bitmap_[word] != kLongMaskAllBitsSet) {
+    summary1_[s1] |= s1Bit;
+  } else {
+    summary1_[s1] &= ~s1Bit;
+  }
 
-  // We can't use this if we're checking too many bits
-  if (count - *pagesAllocated < sizeBits)
-    return false;
+  const auto s2 = s1 / kBitsPerWord;
+  const auto s2Bit = 1ULL << (s1 % kBitsPerWord);
+  if (summary1_[s1] != 0) {
+    summary2_[s2] |= s2Bit;
+  } else {
+    summary2_[s2] &= ~s2Bit;
+  }
+}
 
-  const auto ptr = reinterpret_cast<T*>(bitmap_);
-  const auto i = pageNo / sizeBits;
+void DefaultPhysicalMemoryAllocator::markUsed(size_t startPage,
+                                              size_t endPage) const {
+  for (auto word = startPage / kBitsPerWord; word * kBitsPerWord < endPage;
+       word++) {
+    const auto base = word * kBitsPerWord;
+    const auto lo = startPage > base ? startPage - base : 0;
+    const auto hi = endPage < base + kBitsPerWord ? endPage - base
+                                                  : kBitsPerWord;
+    bitmap_[word] |= wordMask(lo, hi);
+    updateSummary(word);
+  }
+}
 
-  const auto isFree = ptr[i] == 0;
-  if (isFree) {
-    // Mark chunk as used
-    ptr[i] = static_cast<T>(kLongMaskAllBitsSet);
+void DefaultPhysicalMemoryAllocator::markFree(size_t startPage,
+                                              size_t endPage) const {
+  for (auto word = startPage / kBitsPerWord; word * kBitsPerWord < endPage;
+       word++) {
+    const auto base = word * kBitsPerWord;
+    const auto lo = startPage > base ? startPage - base : 0;
+    const auto hi = endPage < base + kBitsPerWord ? endPage - base
+                                                  : kBitsPerWord;
+    bitmap_[word] &= ~wordMask(lo, hi);
+    updateSummary(word);
+  }
+}
 
-    // Advance
-    pageNo += sizeBits - 1;  // Account for page++ in outside loop
-    *pagesAllocated += sizeBits;
+size_t DefaultPhysicalMemoryAllocator::findFree(size_t fromPage) const {
+  auto word = fromPage / kBitsPerWord;
+  if (word >= bitmapWords_)
+    return kNoPage;
+
+  // Rest of the starting word
+  const auto freeBits =
+      ~bitmap_[word] & (kLongMaskAllBitsSet << (fromPage % kBitsPerWord));
+  if (freeBits != 0)
+    return word * kBitsPerWord + __builtin_ctzll(freeBits);
+
+  // Rest of the starting summary word: any later bitmap word with a free page?
+  word++;
+  if (word >= bitmapWords_)
+    return kNoPage;
+  auto s1 = word / kBitsPerWord;
+  auto s1Bits = summary1_[s1] & (kLongMaskAllBitsSet << (word % kBitsPerWord));
+
+  if (s1Bits == 0) {
+    // Jump across whole summary words using the top level
+    s1++;
+    if (s1 >= summary1Words_)
+      return kNoPage;
+    auto s2 = s1 / kBitsPerWord;
+    auto s2Bits = summary2_[s2] & (kLongMaskAllBitsSet << (s1 % kBitsPerWord));
+    while (s2Bits == 0) {
+      if (++s2 >= summary2Words_)
+        return kNoPage;
+      s2Bits = summary2_[s2];
+    }
+    s1 = s2 * kBitsPerWord + __builtin_ctzll(s2Bits);
+    s1Bits = summary1_[s1];
   }
 
-  return isFree;
+  word = s1 * kBitsPerWord + __builtin_ctzll(s1Bits);
+  return word * kBitsPerWord + __builtin_ctzll(~bitmap_[word]);
+}
+
+// First used page in [startPage, limit), or limit if they're all free
+size_t DefaultPhysicalMemoryAllocator::freeRunEnd(size_t startPage,
+                                                  size_t limit) const {
+  // Extend the run a word at a time
+  auto endPage = startPage;
+  while (endPage < limit) {
+    const auto used = bitmap_[endPage / kBitsPerWord] >>
+                      (endPage % kBitsPerWord);
+    if (used == 0) {
+      // Remainder of this word is free
+      endPage += kBitsPerWord - endPage % kBitsPerWord;
+      continue;
+    }
+    endPage += __builtin_ctzll(used);
+    break;
+  }
+  return endPage < limit ? endPage : limit;
 }
 
 rtk::StatusOr<PageSet> DefaultPhysicalMemoryAllocator::allocatePages(
@@ -220,85 +588,82 @@ rtk::StatusOr<PageSet> DefaultPhysicalMemoryAllocator::allocatePages(
     return rtk::StatusCode::OutOfRange;
   }
 
-  const auto startPage = lowestFreePage_;
-  const auto bitmapPages = bitmapSize_ * UINT8_WIDTH;
-  size_t pagesAllocated = 0;
-
-  // Enumerate bitmap in chunks of 1 or 8*2^x bits
-  for (auto page = startPage; page < bitmapPages; page++) {
-    // const auto bitmapPagesLeft = bitmapPages - page;
-    const auto pagesNeeded = count - pagesAllocated;
-    const auto byte = page / UINT8_WIDTH;
-    const auto bit = page % UINT8_WIDTH;
-    const auto align = bit % UINT64_WIDTH;
-
-    // Fast way--try a chunk first.
-    switch (align) {
-      // 64-bit boundary
-      case 0:
-        if (alignedFreeCheckAdvanceAndMark<uint64_t>(page, count,
-                                                     &pagesAllocated))
-          continue;
-        break;
-      // 32-bit boundary
-      case UINT32_WIDTH:
-        if (alignedFreeCheckAdvanceAndMark<uint32_t>(page, count,
-                                                     &pagesAllocated))
-          continue;
-        break;
-      // 16-bit boundary
-      case UINT16_WIDTH:
-      case UINT16_WIDTH * 3:
-        if (alignedFreeCheckAdvanceAndMark<uint16_t>(page, count,
-                                                     &pagesAllocated))
-          continue;
-        break;
-      // 8-bit boundary
-      case UINT8_WIDTH:
-      case UINT8_WIDTH * 3:
-      case UINT8_WIDTH * 5:
-      case UINT8_WIDTH * 7:
-        if (alignedFreeCheckAdvanceAndMark<uint8_t>(page, count,
-                                                    &pagesAllocated))
-          continue;
-        break;
-    }
+  const auto bitmapPages = bitmapWords_ * kBitsPerWord;
 
-    // Slow way, use partial byte
-    auto mask = kByteMaskRightmostBitSet << bit;
-    auto isFree = (bitmap_[byte] & mask) == kByteMaskNoBitsSet;
+  // Jump to the first free page at or above the hint
+  const auto startPage = findFree(lowestFreePage_);
+  if (startPage == kNoPage) {
+    lowestFreePage_ = bitmapPages;  // literally no lowest free page
+    return rtk::StatusCode::OutOfMemory;
+  }
 
-    if (!isFree) {
-      if (pagesAllocated == 0)
-        continue;  // Try another page;
-      break;  // Or, we have broken continuity, that's all the pages we can allocate at this address.
-    }
+  // Broken continuity ends the run; that's all we allocate at this address
+  const auto limit =
+      count < bitmapPages - startPage ? startPage + count : bitmapPages;
+  const auto endPage = freeRunEnd(startPage, limit);
 
-    // Curteously find and update lowestFreePage once we have enough pages
-    if (pagesNeeded == 0) {
-      lowestFreePage_ = page;
-      break;
-    }
+  markUsed(startPage, endPage);
 
-    // Mark used
-    bitmap_[byte] |= mask;
-    pagesAllocated++;
+  // Everything below the run is in use
+  lowestFreePage_ = endPage;
+
+  uintptr_t newPhysicalAddress = startPage * kPageSize;
+  return PageSet{kPageSize, newPhysicalAddress, endPage - startPage};
+}
+
+rtk::StatusCode DefaultPhysicalMemoryAllocator::freePages(
+    PageSet pages) const {
+  CHECK_INIT_STATUS();
+
+  if (pages.pageSize < kPageSize ||
+      pages.count > SIZE_MAX / (pages.pageSize / kPageSize)) {
+    return rtk::StatusCode::OutOfRange;
+  }
+  const auto pageCount = pages.count * (pages.pageSize / kPageSize);
+  const auto startPage = pages.address / kPageSize;
+  const auto endPage = startPage + pageCount;
+  if (endPage < startPage || endPage > bitmapWords_ * kBitsPerWord) {
+    return rtk::StatusCode::OutOfRange;
   }
 
-  if (pagesAllocated == 0) {
-    lowestFreePage_ = bitmapPages;  // literally no lowest free page
-    return rtk::StatusCode::OutOfMemory;
+  markFree(startPage, endPage);
+
+  if (startPage < lowestFreePage_) {
+    lowestFreePage_ = startPage;
   }
 
-  uintptr_t newPhysicalAddress = startPage * kPageSize;
-  return PageSet{kPageSize, newPhysicalAddress, pagesAllocated};
+  return rtk::StatusCode::Ok;
 }
 
-rtk::StatusOr<uintptr_t> DefaultVirtualMemoryAllocator::allocatePage() const {
-  return rtk::StatusCode::NotImplemented;
-}
+rtk::StatusOr<PageSet> DefaultPhysicalMemoryAllocator::allocateContiguous(
+    size_t count, size_t alignment) const {
+  CHECK_INIT_STATUS();
 
-rtk::StatusOr<PageSet> DefaultVirtualMemoryAllocator::allocatePages(
-    size_t _) const {
-  return rtk::StatusCode::NotImplemented;
-}
\ No newline at end of file
+  if (count == 0 || alignment < kPageSize ||
+      (alignment & (alignment - 1)) != 0) {
+    return rtk::StatusCode::OutOfRange;
+  }
+
+  const auto alignPages = alignment / kPageSize;
+  const auto bitmapPages = bitmapWords_ * kBitsPerWord;
+
+  auto fromPage = lowestFreePage_;
+  while (true) {
+    // Next free page, rounded up to the alignment
+    auto startPage = findFree(fromPage);
+    if (startPage == kNoPage)
+      return rtk::StatusCode::OutOfMemory;
+    startPage = (startPage + alignPages - 1) & ~(alignPages - 1);
+    if (startPage >= bitmapPages || count > bitmapPages - startPage)
+      return rtk::StatusCode::OutOfMemory;
+
+    const auto endPage = freeRunEnd(startPage, startPage + count);
+    if (endPage == startPage + count) {
+      markUsed(startPage, endPage);
+      return PageSet{kPageSize, startPage * kPageSize, count};
+    }
+
+    // endPage is in use; look again past it
+    fromPage = endPage + 1;
+  }
+}
@@ -0,0 +1,59 @@
+#include "kernel/pcid.h"
+#include "kernel/sync.h"
+
+using namespace k;
+
+constexpr uint64_t kCr3NoFlush = 1ULL << 63;
+constexpr uint64_t kInvpcidSingleContext = 1;
+constexpr uint64_t kInvpcidAllNonGlobal = 3;
+constexpr int kPcidBits = 12;
+constexpr uint64_t kPcidMask = (1ULL << kPcidBits) - 1;
+
+uint64_t PcidAllocator::cr3For(uintptr_t pml4Paddr,
+                               AddressSpaceTag& tag) const {
+  if (!Features().pcid)
+    return pml4Paddr;
+
+  InterruptGuard noInterrupts;
+  const auto cpu = CurrentCpu();
+  // Past the limit every switch flushes PCID 0
+  if (cpu >= kMaxCpus)
+    return pml4Paddr;
+  auto& pcids = cpus_[cpu];
+  auto& id = tag.ids[cpu];
+
+  // Still ours here: this TLB may hold our translations, keep them
+  if (id != 0 && id >> kPcidBits == pcids.generation)
+    return pml4Paddr | (id & kPcidMask) | kCr3NoFlush;
+
+  if (pcids.next == kPcidCount) {
+    // Out of IDs; every tag may now hold somebody else's translations here
+    pcids.generation++;
+    pcids.next = 1;
+    if (Features().invpcid) {
+      invpcid(kInvpcidAllNonGlobal, 0, 0);
+    } else {
+      flush_tlb_all();
+    }
+  }
+
+  id = pcids.generation << kPcidBits | pcids.next++;
+
+  // No no-flush bit: loading CR3 clears whatever a previous owner left
+  return pml4Paddr | (id & kPcidMask);
+}
+
+void PcidAllocator::switchTo(uintptr_t pml4Paddr, AddressSpaceTag& tag) const {
+  write_cr3(cr3For(pml4Paddr, tag));
+}
+
+void PcidAllocator::release(AddressSpaceTag& tag) const {
+  // Without invpcid the next owner's first CR3 load does the flushing
+  if (Features().pcid && Features().invpcid) {
+    InterruptGuard noInterrupts;
+    const auto cpu = CurrentCpu();
+    if (cpu < kMaxCpus && tag.ids[cpu] >> kPcidBits == cpus_[cpu].generation)
+      invpcid(kInvpcidSingleContext, tag.ids[cpu] & kPcidMask, 0);
+  }
+  tag = {};
+}
@@ -0,0 +1,246 @@
+#include "kernel/profile.h"
+
+using namespace k;
+
+namespace {
+// Open addressing over a power-of-two table
+size_t HashSlot(const void* key, size_t tableSize) {
+  const auto hash = (reinterpret_cast<uintptr_t>(key) >> 4) *
+                    (uintptr_t)0x9E3779B97F4A7C15;
+  return (hash >> 32) & (tableSize - 1);
+}
+}  // namespace
+
+static_assert((AllocationProfiler::kMaxSites &
+               (AllocationProfiler::kMaxSites - 1)) == 0);
+static_assert((AllocationProfiler::kMaxTracked &
+               (AllocationProfiler::kMaxTracked - 1)) == 0);
+
+void AllocationProfiler::setSampling(uint32_t every) const {
+  InterruptGuard noInterrupts;
+  LockGuard guard{lock_};
+  __atomic_store_n(&countdown_, (int64_t)every, __ATOMIC_RELAXED);
+  __atomic_store_n(&every_, every, __ATOMIC_RELAXED);
+}
+
+void AllocationProfiler::addLive(Stats& stats, size_t bytes) {
+  stats.allocations++;
+  stats.bytes += bytes;
+  stats.live++;
+  stats.liveBytes += bytes;
+  if (stats.liveBytes > stats.peakBytes) {
+    stats.peakBytes = stats.liveBytes;
+  }
+}
+
+uint32_t AllocationProfiler::findSite(const void* site) const {
+  auto slot = HashSlot(site, kMaxSites);
+  for (size_t probe = 0; probe < kMaxSites; probe++) {
+    auto& entry = sites_[slot];
+    if (entry.site == site)
+      return slot;
+    if (entry.site == nullptr) {
+      // Keep a few slots free so probes stay short
+      if (siteCount_ >= kMaxSites * 7 / 8)
+        return kNoSite;
+      entry.site = site;
+      siteCount_++;
+      return slot;
+    }
+    slot = (slot + 1) & (kMaxSites - 1);
+  }
+  return kNoSite;
+}
+
+size_t AllocationProfiler::findTracked(const void* ptr) const {
+  auto slot = HashSlot(ptr, kMaxTracked);
+  for (size_t probe = 0; probe < kMaxTracked; probe++) {
+    if (tracked_[slot].ptr == ptr || tracked_[slot].ptr == nullptr)
+      return slot;
+    slot = (slot + 1) & (kMaxTracked - 1);
+  }
+  return kMaxTracked;
+}
+
+void AllocationProfiler::removeTracked(size_t slot) const {
+  // Shift later entries of the run back, so lookups never stop early
+  auto hole = slot;
+  auto next = (slot + 1) & (kMaxTracked - 1);
+  while (tracked_[next].ptr != nullptr) {
+    const auto home = HashSlot(tracked_[next].ptr, kMaxTracked);
+    // Moves back unless its home lies in (hole, next]
+    const auto distance = (next - home) & (kMaxTracked - 1);
+    const auto gap = (next - hole) & (kMaxTracked - 1);
+    if (distance >= gap) {
+      tracked_[hole] = tracked_[next];
+      hole = next;
+    }
+    next = (next + 1) & (kMaxTracked - 1);
+  }
+  tracked_[hole] = Tracked{};
+  __atomic_store_n(&trackedCount_, trackedCount_ - 1, __ATOMIC_RELAXED);
+}
+
+void AllocationProfiler::sample(const void* ptr, size_t bytes, int sizeClass,
+                                const void* site) const {
+  const auto every = sampling();
+  if (every == 0)
+    return;
+  __atomic_add_fetch(&countdown_, (int64_t)every, __ATOMIC_RELAXED);
+  if (ptr == nullptr)
+    return;
+
+  InterruptGuard noInterrupts;
+  LockGuard guard{lock_};
+
+  // Untracked allocations would never leave the live counts
+  if (trackedCount_ >= kMaxTracked * 3 / 4) {
+    dropped_++;
+    return;
+  }
+  const auto siteIndex = findSite(site);
+  if (siteIndex == kNoSite) {
+    dropped_++;
+    return;
+  }
+  if (sizeClass < 0 || sizeClass >= classCount_) {
+    sizeClass = classCount_ - 1;
+  }
+
+  const auto slot = findTracked(ptr);
+  if (slot == kMaxTracked || tracked_[slot].ptr != nullptr) {
+    dropped_++;  // already tracked: a free we never saw
+    return;
+  }
+  tracked_[slot] = Tracked{ptr, bytes, siteIndex, sizeClass};
+  __atomic_store_n(&trackedCount_, trackedCount_ + 1, __ATOMIC_RELAXED);
+
+  addLive(classes_[sizeClass], bytes);
+  addLive(sites_[siteIndex].stats, bytes);
+}
+
+void AllocationProfiler::untrack(const void* ptr) const {
+  InterruptGuard noInterrupts;
+  LockGuard guard{lock_};
+
+  const auto slot = findTracked(ptr);
+  if (slot == kMaxTracked || tracked_[slot].ptr != ptr)
+    return;  // not sampled
+
+  const auto entry = tracked_[slot];
+  auto& classStats = classes_[entry.sizeClass];
+  classStats.live--;
+  classStats.liveBytes -= entry.bytes;
+  auto& siteStats = sites_[entry.site].stats;
+  siteStats.live--;
+  siteStats.liveBytes -= entry.bytes;
+  removeTracked(slot);
+}
+
+AllocationProfiler::Stats AllocationProfiler::classStats(int sizeClass) const {
+  if (sizeClass < 0 || sizeClass >= classCount_)
+    return Stats{};
+  InterruptGuard noInterrupts;
+  LockGuard guard{lock_};
+  return classes_[sizeClass];
+}
+
+size_t AllocationProfiler::siteCount() const {
+  InterruptGuard noInterrupts;
+  LockGuard guard{lock_};
+  return siteCount_;
+}
+
+AllocationProfiler::SiteStats AllocationProfiler::siteStats(
+    size_t index) const {
+  InterruptGuard noInterrupts;
+  LockGuard guard{lock_};
+  for (auto& entry : sites_) {
+    if (entry.site == nullptr)
+      continue;
+    if (index-- == 0)
+      return entry;
+  }
+  return SiteStats{};
+}
+
+size_t AllocationProfiler::dropped() const {
+  InterruptGuard noInterrupts;
+  LockGuard guard{lock_};
+  return dropped_;
+}
+
+void AllocationProfiler::reset() const {
+  InterruptGuard noInterrupts;
+  LockGuard guard{lock_};
+  dropped_ = 0;
+  siteCount_ = 0;
+  for (auto& stats : classes_) {
+    stats = Stats{};
+  }
+  for (auto& entry : sites_) {
+    entry = SiteStats{};
+  }
+  for (auto& entry : tracked_) {
+    entry = Tracked{};
+  }
+  __atomic_store_n(&trackedCount_, (size_t)0, __ATOMIC_RELAXED);
+}
+
+void AllocationProfiler::dump(const rtk::Logger& logger,
+                              rtk::LogLevel level) const {
+  // Copy out first: logging may allocate, and so land back here
+  Stats classes[kMaxClasses];
+  SiteStats top[kDumpSites] = {};
+  size_t topCount = 0;
+  size_t dropped;
+  const auto every = sampling();
+  {
+    InterruptGuard noInterrupts;
+    LockGuard guard{lock_};
+    for (int i = 0; i < classCount_; i++) {
+      classes[i] = classes_[i];
+    }
+    dropped = dropped_;
+
+    // Insertion into a short list, biggest live bytes first
+    for (auto& entry : sites_) {
+      if (entry.site == nullptr)
+        continue;
+      auto i = topCount < kDumpSites ? topCount++ : kDumpSites;
+      while (i > 0 && top[i - 1].stats.liveBytes < entry.stats.liveBytes) {
+        if (i < kDumpSites) {
+          top[i] = top[i - 1];
+        }
+        i--;
+      }
+      if (i < kDumpSites) {
+        top[i] = entry;
+      }
+    }
+  }
+
+  const size_t scale = every == 0 ? 1 : every;
+  logger.log(level, "%s allocations, sampled 1 in %u (0: off), %zu dropped\n",
+             name_, every, dropped);
+  for (int i = 0; i < classCount_; i++) {
+    const auto& stats = classes[i];
+    if (stats.allocations == 0)
+      continue;
+    logger.log(level,
+               "  class %d: %zu allocs, %zu bytes, %zu live, %zu live bytes, "
+               "%zu peak bytes\n",
+               i, stats.allocations * scale, stats.bytes * scale,
+               stats.live * scale, stats.liveBytes * scale,
+               stats.peakBytes * scale);
+  }
+  for (size_t i = 0; i < topCount; i++) {
+    const auto& stats = top[i].stats;
+    logger.log(level,
+               "  site %p: %zu allocs, %zu bytes, %zu live, %zu live bytes, "
+               "%zu peak bytes\n",
+               top[i].site, stats.allocations * scale, stats.bytes * scale,
+               stats.live * scale, stats.liveBytes * scale,
+               stats.peakBytes * scale);
+  }
+}
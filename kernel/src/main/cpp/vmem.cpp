@@ -0,0 +1,400 @@
+#include "kernel.h"
+
+using namespace k;
+
+#define CHECK_INIT_STATUS()                           \
+  do {                                                \
+    if (initializationStatus_ != rtk::StatusCode::Ok) \
+      return rtk::StatusCode::InitializationError;    \
+  } while (0)
+
+struct DefaultVirtualMemoryAllocator::ByAddress {
+  static Link& link(Segment* segment) { return segment->byAddress; }
+  static bool less(const Segment* a, const Segment* b) {
+    return a->start < b->start;
+  }
+
+  // Segment starting at or before `address`, nearest first
+  static Segment* floor(Segment* s, uintptr_t address) {
+    Segment* found = nullptr;
+    while (s != nullptr) {
+      if (s->start <= address) {
+        found = s;
+        s = s->byAddress.right;
+      } else {
+        s = s->byAddress.left;
+      }
+    }
+    return found;
+  }
+
+  // Segment starting exactly at `address`
+  static Segment* at(Segment* s, uintptr_t address) {
+    while (s != nullptr && s->start != address) {
+      s = address < s->start ? s->byAddress.left : s->byAddress.right;
+    }
+    return s;
+  }
+};
+
+// Ties broken by address so keys are unique and best fit prefers low memory
+struct DefaultVirtualMemoryAllocator::BySize {
+  static Link& link(Segment* segment) { return segment->bySize; }
+  static bool less(const Segment* a, const Segment* b) {
+    return a->pages < b->pages ||
+           (a->pages == b->pages && a->start < b->start);
+  }
+
+  // Smallest segment of at least `pages` pages
+  static Segment* bestFit(Segment* s, size_t pages) {
+    Segment* fit = nullptr;
+    while (s != nullptr) {
+      if (s->pages >= pages) {
+        fit = s;
+        s = s->bySize.left;
+      } else {
+        s = s->bySize.right;
+      }
+    }
+    return fit;
+  }
+};
+
+// AVL tree over one of a segment's intrusive links. A segment's key must not
+// change while it's in the tree, except in ways that keep its order.
+template <typename Order>
+class DefaultVirtualMemoryAllocator::Tree {
+ public:
+  static void insert(Segment*& root, Segment* segment) {
+    root = insertAt(root, segment);
+  }
+  static void remove(Segment*& root, Segment* segment) {
+    root = removeAt(root, segment);
+  }
+
+ private:
+  static Segment*& left(Segment* s) { return Order::link(s).left; }
+  static Segment*& right(Segment* s) { return Order::link(s).right; }
+  static int height(Segment* s) {
+    return s != nullptr ? Order::link(s).height : 0;
+  }
+  static void update(Segment* s) {
+    const auto l = height(left(s));
+    const auto r = height(right(s));
+    Order::link(s).height = 1 + (l > r ? l : r);
+  }
+  static Segment* rotateRight(Segment* s) {
+    auto l = left(s);
+    left(s) = right(l);
+    right(l) = s;
+    update(s);
+    update(l);
+    return l;
+  }
+  static Segment* rotateLeft(Segment* s) {
+    auto r = right(s);
+    right(s) = left(r);
+    left(r) = s;
+    update(s);
+    update(r);
+    return r;
+  }
+  static Segment* balance(Segment* s) {
+    update(s);
+    const auto skew = height(left(s)) - height(right(s));
+    if (skew > 1) {
+      if (height(left(left(s))) < height(right(left(s)))) {
+        left(s) = rotateLeft(left(s));
+      }
+      return rotateRight(s);
+    }
+    if (skew < -1) {
+      if (height(right(right(s))) < height(left(right(s)))) {
+        right(s) = rotateRight(right(s));
+      }
+      return rotateLeft(s);
+    }
+    return s;
+  }
+  static Segment* insertAt(Segment* root, Segment* segment) {
+    if (root == nullptr) {
+      Order::link(segment) = {nullptr, nullptr, 1};
+      return segment;
+    }
+    if (Order::less(segment, root)) {
+      left(root) = insertAt(left(root), segment);
+    } else {
+      right(root) = insertAt(right(root), segment);
+    }
+    return balance(root);
+  }
+  static Segment* removeMin(Segment* root, Segment*& min) {
+    if (left(root) == nullptr) {
+      min = root;
+      return right(root);
+    }
+    left(root) = removeMin(left(root), min);
+    return balance(root);
+  }
+  static Segment* removeAt(Segment* root, Segment* segment) {
+    if (root == nullptr)
+      return nullptr;
+    if (root == segment) {
+      auto l = left(segment);
+      auto r = right(segment);
+      if (r == nullptr)
+        return l;
+      Segment* min;
+      r = removeMin(r, min);
+      left(min) = l;
+      right(min) = r;
+      return balance(min);
+    }
+    if (Order::less(segment, root)) {
+      left(root) = removeAt(left(root), segment);
+    } else {
+      right(root) = removeAt(right(root), segment);
+    }
+    return balance(root);
+  }
+};  // class DefaultVirtualMemoryAllocator::Tree
+
+void DefaultVirtualMemoryAllocator::init(
+    const KernelContext* kernel, MemoryBootstrapper& bootstrapper) const {
+  auto& status = initializationStatus_;  // alias
+  kernel_ = kernel;
+
+  // The first page of segment records comes from the bootstrapper like
+  // every other early reservation
+  auto memResult = bootstrapper.reserveVirtualMemory(1);
+  if (!memResult)  // out of mem?
+    return;
+  status = mapSegmentPage(memResult.get());
+  if (status != rtk::StatusCode::Ok)
+    return;
+
+  const auto& layout = kernel->memoryLayout();
+  auto& heap = regions_[(int)VirtualRegion::Heap];
+  auto& maps = regions_[(int)VirtualRegion::MemoryMaps];
+  heap.start = layout.heapStart();
+  heap.end = layout.heapEnd() + 1;
+
+  // Everything the bootstrapper reserved so far stays reserved, and the
+  // regions mustn't overlap
+  maps.start = layout.memoryMapsStart();
+  maps.end = layout.memoryMapsEnd() + 1;
+  if (maps.start < bootstrapper.mappedVirtualMemoryEnd()) {
+    maps.start = bootstrapper.mappedVirtualMemoryEnd();
+  }
+  if (maps.start < heap.end && heap.start < maps.end) {
+    maps.start = heap.end;
+  }
+
+  for (auto& region : regions_) {
+    if (region.start < region.end) {
+      addFree(region, region.start, (region.end - region.start) / kPageSize);
+    }
+  }
+
+  status = rtk::StatusCode::Ok;
+}
+
+rtk::StatusCode DefaultVirtualMemoryAllocator::mapSegmentPage(
+    uintptr_t page) const {
+  auto allocateResult = kernel_->pageAllocator().allocatePage();
+  if (!allocateResult)
+    return allocateResult.status();  // out of mem?
+
+  auto status = kernel_->pageTables().map(page, allocateResult.get(),
+                                          PageAttr::Present | PageAttr::RW);
+  CHECK_STATUS();
+
+  auto segments = reinterpret_cast<Segment*>(page);
+  for (size_t i = 0; i < kPageSize / sizeof(Segment); i++) {
+    releaseSpare(&segments[i]);
+  }
+  return rtk::StatusCode::Ok;
+}
+
+DefaultVirtualMemoryAllocator::Segment*
+DefaultVirtualMemoryAllocator::takeSpare() const {
+  auto segment = spares_;
+  if (segment != nullptr) {
+    spares_ = segment->byAddress.left;
+    spareCount_--;
+  }
+  return segment;
+}
+
+void DefaultVirtualMemoryAllocator::releaseSpare(Segment* segment) const {
+  segment->byAddress.left = spares_;
+  spares_ = segment;
+  spareCount_++;
+}
+
+void DefaultVirtualMemoryAllocator::refillSpares() const {
+  // Record pages come out of the memory maps region. Carving one takes at
+  // most one spare, which is why we keep a few around.
+  auto& maps = regions_[(int)VirtualRegion::MemoryMaps];
+  auto result = allocateIn(maps, 1, 0);
+  if (!result.ok())
+    return;  // out of address space? get by with what's left
+
+  const auto page = result.get().address;
+  if (mapSegmentPage(page) != rtk::StatusCode::Ok) {
+    (void)freeIn(maps, result.get());
+  }
+}
+
+DefaultVirtualMemoryAllocator::Region*
+DefaultVirtualMemoryAllocator::regionFor(uintptr_t address) const {
+  for (auto& region : regions_) {
+    if (address >= region.start && address < region.end)
+      return &region;
+  }
+  return nullptr;
+}
+
+void DefaultVirtualMemoryAllocator::addFree(Region& region, uintptr_t start,
+                                            size_t pages) const {
+  auto segment = takeSpare();
+  segment->start = start;
+  segment->pages = pages;
+  segment->guardPages = 0;
+  Tree<ByAddress>::insert(region.freeByAddress, segment);
+  Tree<BySize>::insert(region.freeBySize, segment);
+}
+
+rtk::StatusOr<PageSet> DefaultVirtualMemoryAllocator::allocateIn(
+    Region& region, size_t count, size_t guardPages) const {
+  const auto total = count + 2 * guardPages;
+  if (count == 0 || total < count) {
+    return rtk::StatusCode::OutOfRange;
+  }
+
+  auto segment = BySize::bestFit(region.freeBySize, total);
+  if (segment == nullptr) {
+    return rtk::StatusCode::OutOfMemory;
+  }
+
+  Segment* used;
+  if (segment->pages == total) {
+    // Exact fit: the free record becomes the allocated one
+    Tree<BySize>::remove(region.freeBySize, segment);
+    Tree<ByAddress>::remove(region.freeByAddress, segment);
+    used = segment;
+  } else {
+    used = takeSpare();
+    if (used == nullptr) {
+      return rtk::StatusCode::OutOfMemory;
+    }
+    // Carve from the front; the rest keeps its place in the address tree
+    Tree<BySize>::remove(region.freeBySize, segment);
+    used->start = segment->start;
+    used->pages = total;
+    segment->start += total * kPageSize;
+    segment->pages -= total;
+    Tree<BySize>::insert(region.freeBySize, segment);
+  }
+
+  used->guardPages = guardPages;
+  Tree<ByAddress>::insert(region.allocated, used);
+
+  return PageSet{kPageSize, used->start + guardPages * kPageSize, count};
+}
+
+rtk::StatusCode DefaultVirtualMemoryAllocator::freeIn(Region& region,
+                                                      PageSet pages) const {
+  // Allocated segments are keyed by their first guard page
+  auto used = ByAddress::floor(region.allocated, pages.address);
+  const auto count = pages.count * (pages.pageSize / kPageSize);
+  if (used == nullptr ||
+      used->start + used->guardPages * kPageSize != pages.address ||
+      used->pages != count + 2 * used->guardPages) {
+    return rtk::StatusCode::OutOfRange;  // not something we handed out
+  }
+  Tree<ByAddress>::remove(region.allocated, used);
+
+  // Coalesce with free neighbours on either side
+  auto prev = ByAddress::floor(region.freeByAddress, used->start);
+  if (prev != nullptr && prev->end() != used->start) {
+    prev = nullptr;
+  }
+  auto next = ByAddress::at(region.freeByAddress, used->end());
+
+  if (prev != nullptr) {
+    Tree<BySize>::remove(region.freeBySize, prev);
+    prev->pages += used->pages;
+    releaseSpare(used);
+    if (next != nullptr) {
+      Tree<BySize>::remove(region.freeBySize, next);
+      Tree<ByAddress>::remove(region.freeByAddress, next);
+      prev->pages += next->pages;
+      releaseSpare(next);
+    }
+    Tree<BySize>::insert(region.freeBySize, prev);
+  } else if (next != nullptr) {
+    Tree<BySize>::remove(region.freeBySize, next);
+    next->start = used->start;
+    next->pages += used->pages;
+    releaseSpare(used);
+    Tree<BySize>::insert(region.freeBySize, next);
+  } else {
+    used->guardPages = 0;
+    Tree<ByAddress>::insert(region.freeByAddress, used);
+    Tree<BySize>::insert(region.freeBySize, used);
+  }
+
+  return rtk::StatusCode::Ok;
+}
+
+rtk::StatusOr<uintptr_t> DefaultVirtualMemoryAllocator::allocatePage() const {
+  return allocatePages(1).map([](auto pageSet) { return pageSet.address; });
+}
+
+rtk::StatusOr<PageSet> DefaultVirtualMemoryAllocator::allocatePages(
+    size_t count) const {
+  return allocatePages(count, VirtualRegion::Heap, 0);
+}
+
+rtk::StatusOr<PageSet> DefaultVirtualMemoryAllocator::allocatePages(
+    size_t count, VirtualRegion region, size_t guardPages) const {
+  CHECK_INIT_STATUS();
+
+  InterruptGuard noInterrupts;
+  LockGuard guard{lock_};
+
+  if (spareCount_ < kSpareSegments) {
+    refillSpares();
+  }
+  return allocateIn(regions_[(int)region], count, guardPages);
+}
+
+rtk::StatusCode DefaultVirtualMemoryAllocator::freePages(PageSet pages) const {
+  CHECK_INIT_STATUS();
+
+  InterruptGuard noInterrupts;
+  LockGuard guard{lock_};
+
+  auto region = regionFor(pages.address);
+  if (region == nullptr) {
+    return rtk::StatusCode::OutOfRange;
+  }
+  return freeIn(*region, pages);
+}
+
+bool DefaultVirtualMemoryAllocator::contains(uintptr_t address) const {
+  if (initializationStatus_ != rtk::StatusCode::Ok)
+    return false;
+
+  InterruptGuard noInterrupts;
+  LockGuard guard{lock_};
+
+  auto region = regionFor(address);
+  if (region == nullptr)
+    return false;
+  auto used = ByAddress::floor(region->allocated, address);
+  return used != nullptr &&
+         address >= used->start + used->guardPages * kPageSize &&
+         address < used->end() - used->guardPages * kPageSize;
+}
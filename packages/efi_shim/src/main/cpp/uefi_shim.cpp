@@ -31,7 +31,7 @@ extern "C" void kernel_boot_uefi(const boot_info_t* bootInfo) {
   rtk::StatusCode _ = kernel_main(*kernelContext);
 
   // Loop forever
-  freeze();
+  idle();
 }
 
 UefiMemoryBootstrapper::~UefiMemoryBootstrapper() noexcept {
@@ -40,10 +40,8 @@ UefiMemoryBootstrapper::~UefiMemoryBootstrapper() noexcept {
     auto& d = *descriptor(memoryMap_, i);
 
     if (shouldBeUnmapped(d.Type)) {
-      for (size_t j = 0; j < d.NumberOfPages; j++) {
-        auto entry = PT_ENTRY_PTR(d.PhysicalStart + EFI_PAGE_SIZE * j);
-        *entry = 0;  // Unmap the page.
-      }
+      // Flushes the stale translations and frees emptied tables
+      (void)Context().pageTables().unmap(d.NumberOfPages, d.PhysicalStart);
       break;
     }
   }
@@ -93,6 +91,19 @@ rtk::StatusOr<PageSet> UefiBootstrapPhysicalMemoryAllocator::allocatePages(
   return rtk::StatusCode::OutOfMemory;
 }
 
+rtk::StatusCode UefiBootstrapPhysicalMemoryAllocator::freePages(
+    k::PageSet _) const {
+  // Bootstrap allocations live for the lifetime of the kernel
+  return rtk::StatusCode::NotImplemented;
+}
+
+rtk::StatusOr<PageSet>
+UefiBootstrapPhysicalMemoryAllocator::allocateContiguous(
+    size_t count, size_t alignment) const {
+  // Only needed once the real allocator is up
+  return rtk::StatusCode::NotImplemented;
+}
+
 bool UefiMemoryBootstrapper::UefiFreePhysicalMemoryRange::move_next() {
   for (auto& i = parent_.descriptorIndex_;
        i < static_cast<int>(parent_.descriptorCount_); i++) {